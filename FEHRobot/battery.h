@@ -0,0 +1,103 @@
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <FEHBattery.h>
+#include "scheduler.h"
+
+// Voltage motor outputs are scaled to (V), the firmware assumes this for SetPercent
+#define NOMINAL_VOLTAGE 11.7
+
+// Battery sampling rate (Hz) and filter (0 to 1, higher is smoother, ~1 s at 10 Hz)
+#define BATTERY_RATE 10
+#define BATTERY_FILTER 0.9
+
+// Limits on the compensation scale
+#define MIN_VOLTAGE_SCALE 0.8
+#define MAX_VOLTAGE_SCALE 1.3
+
+// Readings below this are bad (V)
+#define MIN_VALID_VOLTAGE 5.0
+
+// Battery voltage compensation
+// Same percent gives the same motor voltage (so the same speed) on a fresh or a sagging battery:
+// output is scaled by nominal / filtered battery voltage
+class BatteryMonitor {
+    public:
+        BatteryMonitor();
+        void start();
+        void update();
+        float voltage();
+        float scale();
+        float compensate(float percent);
+    private:
+        float filtered;
+        static void task();
+};
+
+// Declare battery monitor
+BatteryMonitor battery;
+
+// BatteryMonitor object constructor
+// Assumes nominal voltage until sampled
+BatteryMonitor::BatteryMonitor() {
+    filtered = NOMINAL_VOLTAGE;
+}
+
+// BatteryMonitor function start
+// Takes first sample and registers sampling task
+void BatteryMonitor::start() {
+    float v = recorder.battery();
+    if (v > MIN_VALID_VOLTAGE) {
+        filtered = v;
+    }
+    scheduler.addTask(task, BATTERY_RATE);
+}
+
+// BatteryMonitor function update
+// Filters a new sample
+void BatteryMonitor::update() {
+    float v = recorder.battery();
+    if (v > MIN_VALID_VOLTAGE) {
+        filtered = BATTERY_FILTER * filtered + (1 - BATTERY_FILTER) * v;
+    }
+}
+
+// BatteryMonitor function voltage
+// Filtered battery voltage
+float BatteryMonitor::voltage() {
+    return filtered;
+}
+
+// BatteryMonitor function scale
+// Factor applied to motor outputs
+float BatteryMonitor::scale() {
+    float s = NOMINAL_VOLTAGE / filtered;
+    if (s < MIN_VOLTAGE_SCALE) {
+        s = MIN_VOLTAGE_SCALE;
+    }
+    else if (s > MAX_VOLTAGE_SCALE) {
+        s = MAX_VOLTAGE_SCALE;
+    }
+    return s;
+}
+
+// BatteryMonitor function compensate
+// Scales percent to nominal voltage, limited to [-100, 100]
+float BatteryMonitor::compensate(float percent) {
+    percent *= scale();
+    if (percent > 100) {
+        percent = 100;
+    }
+    else if (percent < -100) {
+        percent = -100;
+    }
+    return percent;
+}
+
+// BatteryMonitor function task
+// Sampling task registered with the scheduler
+void BatteryMonitor::task() {
+    battery.update();
+}
+
+#endif // BATTERY_H
@@ -0,0 +1,277 @@
+#ifndef EKF_H
+#define EKF_H
+
+#include <FEHAccel.h>
+#include <cmath>
+#include "scheduler.h"
+#include "odometry.h"
+#include "rps.h"
+
+#define PI 3.1415926536
+
+// Wheel distance noise (in^2 per in traveled)
+#define EKF_WHEEL_NOISE 0.01
+
+// RPS noise (standard deviation in inches and degrees)
+#define EKF_RPS_XY_NOISE 0.5
+#define EKF_RPS_HEADING_NOISE 2.0
+
+// Reject RPS values further than this many standard deviations from the estimate
+#define EKF_GATE 4.0
+
+// Accelerometer thresholds (g): tilted (on ramp) and slipping (sideways jerk or bump)
+#define TILT_THRESHOLD 0.2
+#define SLIP_THRESHOLD 0.5
+
+// Wheel noise multiplier while tilted or slipping
+#define SLIP_NOISE 25.0
+
+// Pose estimator
+// Extended Kalman filter on (x, y, heading) in RPS coordinates
+// Predicts with wheel odometry, corrects with RPS whenever the cache has a new valid packet
+// Accelerometer gates the prediction: on the ramp wheel distance is projected onto
+// the floor, and while tilted or bumped the wheels are trusted less
+// Until the first RPS fix the pose is relative to where the filter started
+// x, y in inches and heading in degrees [0, 360), same as RPS
+class EKF {
+    public:
+        EKF();
+        void start();
+        void update();
+        void predict(float deltaL, float deltaR, float noise);
+        void correct(int index, float measured, float variance);
+        float x();
+        float y();
+        float heading();
+        float variance(int index);
+        bool hasFix();
+    private:
+        float state[3];
+        float P[3][3];
+        float lastL, lastR;
+        unsigned long lastSequence;
+        bool fix;
+        static void task();
+};
+
+// Declare estimator
+EKF ekf;
+
+// Wraps angle to [-pi, pi]
+float wrapAngle(float angle) {
+    while (angle > PI) {
+        angle -= 2 * PI;
+    }
+    while (angle < -PI) {
+        angle += 2 * PI;
+    }
+    return angle;
+}
+
+// EKF object constructor
+// Pose at origin, no RPS fix yet
+EKF::EKF() {
+    for (int i = 0; i < 3; i++) {
+        state[i] = 0;
+        for (int j = 0; j < 3; j++) {
+            P[i][j] = 0;
+        }
+    }
+    lastL = 0;
+    lastR = 0;
+    lastSequence = 0;
+    fix = false;
+}
+
+// EKF function start
+// Takes current odometry as reference and registers update task
+void EKF::start() {
+    lastL = odometry.leftDistance();
+    lastR = odometry.rightDistance();
+    scheduler.addTask(task, CONTROL_RATE);
+}
+
+// EKF function update
+// One filter step: predict with new wheel distances, then correct with RPS if it changed
+void EKF::update() {
+    // Wheel distances since last step
+    odometry.update();
+    float deltaL = odometry.leftDistance() - lastL;
+    float deltaR = odometry.rightDistance() - lastR;
+    lastL = odometry.leftDistance();
+    lastR = odometry.rightDistance();
+
+    // Accelerometer gating
+    float pitch = recorder.accelY(), side = recorder.accelX();
+    float noise = EKF_WHEEL_NOISE;
+    if (fabs(pitch) > TILT_THRESHOLD) {
+        // Only the horizontal part of the wheel distance moves the robot on the course
+        float level = pitch * pitch < 1 ? sqrt(1 - pitch * pitch) : 0;
+        deltaL *= level;
+        deltaR *= level;
+        noise *= SLIP_NOISE;
+    }
+    if (fabs(side) > SLIP_THRESHOLD) {
+        noise *= SLIP_NOISE;
+    }
+
+    predict(deltaL, deltaR, noise);
+
+    // Only use each packet once, and only if it's valid
+    const RPSSnapshot &packet = rps.get();
+    if (packet.sequence == lastSequence) {
+        return;
+    }
+    lastSequence = packet.sequence;
+    if (!packet.valid()) {
+        return;
+    }
+    float x = packet.x, y = packet.y, heading = packet.heading;
+
+    float headingNoise = EKF_RPS_HEADING_NOISE * PI / 180;
+
+    // First fix sets the pose
+    if (!fix) {
+        state[0] = x;
+        state[1] = y;
+        state[2] = wrapAngle(heading * PI / 180);
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                P[i][j] = 0;
+            }
+        }
+        P[0][0] = EKF_RPS_XY_NOISE * EKF_RPS_XY_NOISE;
+        P[1][1] = EKF_RPS_XY_NOISE * EKF_RPS_XY_NOISE;
+        P[2][2] = headingNoise * headingNoise;
+        fix = true;
+        return;
+    }
+
+    // Noise is independent, so x, y and heading are corrected one at a time
+    correct(0, x, EKF_RPS_XY_NOISE * EKF_RPS_XY_NOISE);
+    correct(1, y, EKF_RPS_XY_NOISE * EKF_RPS_XY_NOISE);
+    correct(2, heading * PI / 180, headingNoise * headingNoise);
+}
+
+// EKF function predict
+// Moves pose by wheel distances (in) and grows covariance
+// noise is wheel variance per inch traveled
+void EKF::predict(float deltaL, float deltaR, float noise) {
+    float distance = (deltaL + deltaR) / 2;
+    float deltaTheta = (deltaR - deltaL) / TRACK_WIDTH;
+    float phi = state[2] + deltaTheta / 2;
+    float c = cos(phi), s = sin(phi);
+
+    state[0] += distance * c;
+    state[1] += distance * s;
+    state[2] = wrapAngle(state[2] + deltaTheta);
+
+    // Jacobian of the motion with respect to the state
+    float F[3][3] = {
+        { 1, 0, -distance * s },
+        { 0, 1, distance * c },
+        { 0, 0, 1 }
+    };
+
+    // Jacobian with respect to the wheel distances
+    float arm = distance / (2 * TRACK_WIDTH), turn = 1 / TRACK_WIDTH;
+    float G[3][2] = {
+        { c / 2 + arm * s, c / 2 - arm * s },
+        { s / 2 - arm * c, s / 2 + arm * c },
+        { -turn, turn }
+    };
+
+    // Wheel noise grows with distance traveled
+    float varL = noise * fabs(deltaL), varR = noise * fabs(deltaR);
+
+    // P = F P F' + G Q G'
+    float FP[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            FP[i][j] = 0;
+            for (int k = 0; k < 3; k++) {
+                FP[i][j] += F[i][k] * P[k][j];
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            float sum = G[i][0] * varL * G[j][0] + G[i][1] * varR * G[j][1];
+            for (int k = 0; k < 3; k++) {
+                sum += FP[i][k] * F[j][k];
+            }
+            P[i][j] = sum;
+        }
+    }
+}
+
+// EKF function correct
+// Scalar measurement of one state (0 x, 1 y, 2 heading in radians)
+// Measurements too far from the estimate are rejected
+void EKF::correct(int index, float measured, float variance) {
+    float innovation = measured - state[index];
+    if (index == 2) {
+        innovation = wrapAngle(innovation);
+    }
+
+    float S = P[index][index] + variance;
+    if (innovation * innovation > EKF_GATE * EKF_GATE * S) {
+        return;
+    }
+
+    // Kalman gain is column index of P over S
+    float K[3];
+    for (int i = 0; i < 3; i++) {
+        K[i] = P[i][index] / S;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        state[i] += K[i] * innovation;
+    }
+    state[2] = wrapAngle(state[2]);
+
+    // P = (I - K H) P, H selects row index
+    float row[3] = { P[index][0], P[index][1], P[index][2] };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            P[i][j] -= K[i] * row[j];
+        }
+    }
+}
+
+// EKF function x
+float EKF::x() {
+    return state[0];
+}
+
+// EKF function y
+float EKF::y() {
+    return state[1];
+}
+
+// EKF function heading
+// Degrees in [0, 360) like RPS
+float EKF::heading() {
+    float degrees = state[2] * 180 / PI;
+    return degrees < 0 ? degrees + 360 : degrees;
+}
+
+// EKF function variance
+// Uncertainty of one state (0 x, 1 y in in^2, 2 heading in rad^2)
+float EKF::variance(int index) {
+    return P[index][index];
+}
+
+// EKF function hasFix
+// True once RPS has given a position
+bool EKF::hasFix() {
+    return fix;
+}
+
+// EKF function task
+// Update task registered with the scheduler
+void EKF::task() {
+    ekf.update();
+}
+
+#endif // EKF_H
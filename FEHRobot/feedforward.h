@@ -0,0 +1,46 @@
+#ifndef FEEDFORWARD_H
+#define FEEDFORWARD_H
+
+#include "ffgains.h"
+
+// Feedforward gains of one motor turning one way
+struct MotorGains {
+    float kS, kV, kA;
+};
+
+// Feedforward model of one motor
+// Motors are not symmetric, so each direction has its own gains
+// Velocity and acceleration are in the motor's own direction (positive for positive percent)
+struct MotorModel {
+    MotorGains positive, negative;
+};
+
+// Models of the base motors (gains from ffgains.h)
+const MotorModel LEFT_MODEL = {
+    { LEFT_KS_POS, LEFT_KV_POS, LEFT_KA_POS },
+    { LEFT_KS_NEG, LEFT_KV_NEG, LEFT_KA_NEG }
+};
+
+const MotorModel RIGHT_MODEL = {
+    { RIGHT_KS_POS, RIGHT_KV_POS, RIGHT_KA_POS },
+    { RIGHT_KS_NEG, RIGHT_KV_NEG, RIGHT_KA_NEG }
+};
+
+// Motor percent needed for velocity (in/s) and acceleration (in/s^2)
+// percent = kS sign(v) + kV v + kA a
+// Direction (and static friction) follows velocity, or acceleration when starting from rest
+float feedforward(const MotorModel &model, float velocity, float acceleration) {
+    float direction = velocity != 0 ? velocity : acceleration;
+
+    if (direction > 0) {
+        const MotorGains &g = model.positive;
+        return g.kS + g.kV * velocity + g.kA * acceleration;
+    }
+    else if (direction < 0) {
+        const MotorGains &g = model.negative;
+        return -g.kS + g.kV * velocity + g.kA * acceleration;
+    }
+    return 0;
+}
+
+#endif // FEEDFORWARD_H
@@ -0,0 +1,24 @@
+#ifndef FFGAINS_H
+#define FFGAINS_H
+
+// Feedforward gains
+// Generated by tools/fitFeedforward from trueSpeed logs, regenerate with
+// fitFeedforward logs... > FEHRobot/ffgains.h
+// kS percent, kV percent per in/s, kA percent per in/s^2
+// POS/NEG is the sign of the motor percent
+
+// Placeholder values from the old MIN_SPEED and KV until the robot is characterized
+#define LEFT_KS_POS 10.0
+#define LEFT_KV_POS 3.0
+#define LEFT_KA_POS 0.0
+#define LEFT_KS_NEG 10.0
+#define LEFT_KV_NEG 3.0
+#define LEFT_KA_NEG 0.0
+#define RIGHT_KS_POS 10.0
+#define RIGHT_KV_POS 3.0
+#define RIGHT_KA_POS 0.0
+#define RIGHT_KS_NEG 10.0
+#define RIGHT_KV_NEG 3.0
+#define RIGHT_KA_NEG 0.0
+
+#endif // FFGAINS_H
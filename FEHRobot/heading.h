@@ -0,0 +1,170 @@
+#ifndef HEADING_H
+#define HEADING_H
+
+#include <cmath>
+#include "scheduler.h"
+#include "odometry.h"
+#include "ekf.h"
+#include "rps.h"
+
+// Heading controller gains (percent per degree, percent per degree/s)
+#define KP_HEADING 0.8
+#define KD_HEADING 0.05
+
+// Output that just overcomes friction when turning in place
+#define MIN_SPEED_HEADING 12
+
+// Maximum turning output
+#define MAX_SPEED_HEADING 35
+
+// Settled when within tolerance (degrees) and slower than rate (degrees/s) for some time (s)
+#define HEADING_TOLERANCE 0.5
+#define HEADING_SETTLE_RATE 5.0
+#define HEADING_SETTLE_TIME 0.1
+
+// Give up after this long (s)
+#define HEADING_TIMEOUT 3.0
+
+// Heading derivative filter (0 to 1, higher is smoother)
+#define HEADING_RATE_FILTER 0.6
+
+// Heading controller
+// PD on the fused heading (EKF, falls back to RPS before it has a fix) at CONTROL_RATE
+// Error is wrapped to [-180, 180] so any target works and the shortest turn is taken
+// Minimum speed is added as feedforward so small errors still move the robot
+class HeadingController {
+    public:
+        static void turnTo(float target);
+        static float error(float target, float heading);
+    private:
+        static float target;
+        static float lastHeading, rate;
+        static float dt;
+        static unsigned long startTime, settleStart;
+        static bool settling, done;
+        static float heading();
+        static void task();
+        static bool isDone();
+};
+
+float HeadingController::target;
+float HeadingController::lastHeading;
+float HeadingController::rate;
+float HeadingController::dt;
+unsigned long HeadingController::startTime;
+unsigned long HeadingController::settleStart;
+bool HeadingController::settling;
+bool HeadingController::done;
+
+// HeadingController function error
+// Target minus heading wrapped to [-180, 180] degrees
+float HeadingController::error(float target, float heading) {
+    float e = fmod(target - heading, 360);
+    if (e > 180) {
+        e -= 360;
+    }
+    else if (e < -180) {
+        e += 360;
+    }
+    return e;
+}
+
+// HeadingController function heading
+// Fused heading if available, latest RPS packet otherwise (negative if invalid)
+float HeadingController::heading() {
+    if (ekf.hasFix()) {
+        return ekf.heading();
+    }
+    if (!rps.get().valid()) {
+        return -1;
+    }
+    return rps.get().heading;
+}
+
+// HeadingController function task
+// One step of the PD loop, stops motors once settled
+void HeadingController::task() {
+    float current = heading();
+    float t = (timeMicros() - startTime) / 1000000.0;
+
+    if (t > HEADING_TIMEOUT) {
+        done = true;
+    }
+
+    // No heading, hold still until it comes back
+    if (current < 0) {
+        setLeft(0);
+        setRight(0);
+        return;
+    }
+
+    // Filtered rate of turn (derivative on measurement, no kick when target changes)
+    if (lastHeading < 0) {
+        lastHeading = current;
+    }
+    float newRate = error(current, lastHeading) / dt;
+    rate = HEADING_RATE_FILTER * rate + (1 - HEADING_RATE_FILTER) * newRate;
+    lastHeading = current;
+
+    float e = error(target, current);
+
+    // Settle check
+    if (fabs(e) < HEADING_TOLERANCE && fabs(rate) < HEADING_SETTLE_RATE) {
+        if (!settling) {
+            settling = true;
+            settleStart = timeMicros();
+        }
+        else if ((timeMicros() - settleStart) / 1000000.0 > HEADING_SETTLE_TIME) {
+            done = true;
+        }
+    }
+    else {
+        settling = false;
+    }
+
+    // PD plus minimum speed feedforward, nothing inside tolerance
+    float out = 0;
+    if (fabs(e) >= HEADING_TOLERANCE) {
+        out = KP_HEADING * e - KD_HEADING * rate;
+        out += e > 0 ? MIN_SPEED_HEADING : -MIN_SPEED_HEADING;
+
+        if (out > MAX_SPEED_HEADING) {
+            out = MAX_SPEED_HEADING;
+        }
+        else if (out < -MAX_SPEED_HEADING) {
+            out = -MAX_SPEED_HEADING;
+        }
+    }
+
+    // Positive output turns left (counterclockwise)
+    setLeft(out);
+    setRight(out);
+}
+
+// HeadingController function isDone
+// Tells the scheduler when to stop
+bool HeadingController::isDone() {
+    return done;
+}
+
+// HeadingController function turnTo
+// Blocking turn in place to target heading (degrees, RPS frame)
+void HeadingController::turnTo(float newTarget) {
+    target = newTarget;
+    startTime = timeMicros();
+    lastHeading = heading();
+    rate = 0;
+    settling = false;
+    done = false;
+
+    // Derivative uses the period the scheduler actually runs the task at
+    int id = scheduler.addTask(task, CONTROL_RATE);
+    dt = scheduler.period(id);
+    scheduler.run(isDone);
+    scheduler.removeTask(id);
+
+    setLeft(0);
+    setRight(0);
+}
+
+#endif // HEADING_H
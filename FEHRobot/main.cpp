@@ -7,29 +7,14 @@
 #include <FEHRPS.h>
 #include <FEHBattery.h>
 #include "plib.h"
-
-// Minimum speeds
-#define MIN_SPEED 10
-#define MIN_SPEED_TURNING 16
-#define MIN_SPEED_SWEEP 18
-
-// Maximum movement speed
-#define MAX_SPEED 60
-
-// P loop speed
-#define LOOP_TIME 0.020
-
-// Slew rate limit per iteration
-#define MAX_STEP 7
-
-// kP for movements
-#define KP_DRIVE 0.4
-#define KP_TURN 0.4
-#define KP_SWEEP 0.6
-#define KP_DRIFT 0.5
-
-// Conversion from ticks to inches
-#define TICKS_PER_INCH 2
+#include "record.h"
+#include "rps.h"
+#include "odometry.h"
+#include "ekf.h"
+#include "heading.h"
+#include "motion.h"
+#include "motionqueue.h"
+#include "route.h"
 
 // Servo values
 #define ARM_DOWN 156
@@ -43,13 +28,21 @@
 #define RPS_TARGET_X 29.8
 #define RPS_TARGET_Y 52
 
-// RPS angle tolerance
-#define EPSILON 0.5
+// Ramp speeds (in/s) and heading correction (in/s per degree)
+// The old code climbed at the approach's 50% power (its -70/90 were never applied),
+// 13 in/s is 49% with the placeholder ffgains.h. Only raise the climb speed once
+// ffgains.h holds measured values and the climb has been tested
+#define RAMP_APPROACH_SPEED 13
+#define RAMP_CLIMB_SPEED 13
+#define KP_RAMP 0.2
 
 // CdS cell thresholds: Red [0, 0.95], Blue [0.95, 1.7], No Light
 #define NO_LIGHT_THRESHOLD 1.7
 #define BLUE_LIGHT_THRESHOLD 0.95
 
+// The log is closed this long after the start (s), even if the run never ends
+#define RUN_TIME_LIMIT 150
+
 // CdS cell light values
 enum {
     NO_LIGHT,
@@ -64,12 +57,12 @@ FEHServo armServo(FEHServo::Servo0);
 FEHMotor leftBase(FEHMotor::Motor0, 9);
 FEHMotor rightBase(FEHMotor::Motor1, 9);
 
-// Declare encoders
-DigitalEncoder rightEnc(FEHIO::P0_0);
-DigitalEncoder leftEnc(FEHIO::P1_0);
+// Declare encoders (reads go through the recorder)
+RecordedEncoder rightEnc(FEHIO::P0_0, RECORD_RIGHT_ENCODER);
+RecordedEncoder leftEnc(FEHIO::P1_0, RECORD_LEFT_ENCODER);
 
 // Declare CdS cell
-AnalogInputPin cds(FEHIO::P0_7);
+RecordedAnalog cds(FEHIO::P0_7, RECORD_CDS);
 
 // Needed for getting RPS coordinates after climbing ramp
 float xPos = 0, yPos = 0;
@@ -91,7 +84,7 @@ void adjustServo() {
     LCD.WriteRC(armDown, 4, 0);
 
     // Wait for touch
-    while (!LCD.Touch(&x, &y)) {
+    while (!recorder.touch(&x, &y)) {
         Sleep(10);
     }
 
@@ -108,19 +101,21 @@ void adjustServo() {
 
     armServo.SetDegree(armUp);
 
-    while (LCD.Touch(&x, &y)) {
+    while (recorder.touch(&x, &y)) {
         Sleep(10);
     }
 }
 
-// Displays RPS coordinates
+// Displays RPS coordinates from latest snapshot
 void displayRPS() {
+    const RPSSnapshot &packet = rps.get();
+
     LCD.WriteRC("X:        ", 0, 0);
-    LCD.WriteRC(RPS.X(), 0, 2);
+    LCD.WriteRC(packet.x, 0, 2);
     LCD.WriteRC("Y:        ", 2, 0);
-    LCD.WriteRC(RPS.Y(), 2, 2);
+    LCD.WriteRC(packet.y, 2, 2);
     LCD.WriteRC("T:        ", 4, 0);
-    LCD.WriteRC(RPS.Heading(), 4, 2);
+    LCD.WriteRC(packet.heading, 4, 2);
 }
 
 // Displays encoder values, CdS cell value, RPS offset, and voltage
@@ -136,804 +131,47 @@ void displayOther(float postRampX, float postRampY) {
     LCD.WriteRC("        ", 12, 12);
     LCD.WriteRC(postRampY, 12, 12);
     LCD.WriteRC("       ", 0, 12);
-    LCD.WriteRC(Battery.Voltage(), 0 , 12);
-}
-
-// Simple PID control loop
-// target is desired encoder count
-// Position PID when some distance away
-// DriftPI PID and slew rate are constantly active
-// Ends function once at location
-// MAX_STEP is slew rate limit (7%)
-// LOOP_TIME is time per update (20 ms)
-void autoDriveF(float target) {
-    PID basePID(KP_DRIVE), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED) {
-                outL = MIN_SPEED * outL / fabs(outL);
-            }
-            else if(fabs(outL) > MAX_SPEED) {
-                outL = MAX_SPEED * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED) {
-                outR = MIN_SPEED * outR / fabs(outR);
-            }
-            else if(fabs(outR) > MAX_SPEED) {
-                outR = MAX_SPEED * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(-outL);
-        rightBase.SetPercent(outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Backward
-void autoDriveB(float target) {
-    PID basePID(KP_DRIVE), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED) {
-                outL = MIN_SPEED * outL / fabs(outL);
-            }
-            else if(fabs(outL) > MAX_SPEED) {
-                outL = MAX_SPEED * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED) {
-                outR = MIN_SPEED * outR / fabs(outR);
-            }
-            else if(fabs(outR) > MAX_SPEED) {
-                outR = MAX_SPEED * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(outL);
-        rightBase.SetPercent(-outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Left turn
-void autoTurnL(float target) {
-    PID basePID(KP_TURN), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED_TURNING) {
-                outL = MIN_SPEED_TURNING * outL / fabs(outL);
-            }
-            else if(fabs(outL) > MAX_SPEED) {
-                outL = MAX_SPEED * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED_TURNING) {
-                outR = MIN_SPEED_TURNING * outR / fabs(outR);
-            }
-            else if(fabs(outR) > MAX_SPEED) {
-                outR = MAX_SPEED * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(outL);
-        rightBase.SetPercent(outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Right turn
-void autoTurnR(float target) {
-    PID basePID(KP_TURN), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED_TURNING) {
-                outL = MIN_SPEED_TURNING * outL / fabs(outL);
-            }
-            else if(fabs(outL) > MAX_SPEED) {
-                outL = MAX_SPEED * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED_TURNING) {
-                outR = MIN_SPEED_TURNING * outR / fabs(outR);
-            }
-            else if(fabs(outR) > MAX_SPEED) {
-                outR = MAX_SPEED * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(-outL);
-        rightBase.SetPercent(-outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Left sweep turn
-void autoSweepL(float target) {
-    PID basePID(KP_SWEEP);
-
-    bool done = false;
-    float out, lastOut = 0;
-    float counts;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        counts = leftEnc.Counts();
-
-        // Position PID
-        out = basePID.calculate(target, counts);
-
-        // Slew rate limit
-        if(out - lastOut > MAX_STEP) {
-            out = lastOut + MAX_STEP;
-        }
-        else if(out - lastOut < -MAX_STEP) {
-            out = lastOut - MAX_STEP;
-        }
-
-        // Make sure output is at least minimum speed (prevent division by 0 too)
-        if(out != 0) {
-            if(fabs(out) < MIN_SPEED_SWEEP) {
-                out = MIN_SPEED_SWEEP * out / fabs(out);
-            }
-            else if(fabs(out) > MAX_SPEED) {
-                out = MAX_SPEED * out / fabs(out);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(-out);
-
-        // Store output for slew rate
-        lastOut = out;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - counts < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Right sweep turn
-void autoSweepR(float target) {
-    PID basePID(KP_SWEEP);
-
-    bool done = false;
-    float out, lastOut = 0;
-    float counts;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        counts = rightEnc.Counts();
-
-        // Position PID
-        out = basePID.calculate(target, counts);
-
-        // Slew rate limit
-        if(out - lastOut > MAX_STEP) {
-            out = lastOut + MAX_STEP;
-        }
-        else if(out - lastOut < -MAX_STEP) {
-            out = lastOut - MAX_STEP;
-        }
-
-        // Make sure output is at least minimum speed (prevent division by 0 too)
-        if(out != 0) {
-            if(fabs(out) < MIN_SPEED_SWEEP) {
-                out = MIN_SPEED_SWEEP * out / fabs(out);
-            }
-            else if(fabs(out) > MAX_SPEED) {
-                out = MAX_SPEED * out / fabs(out);
-            }
-        }
-
-        // Set motors to output
-        rightBase.SetPercent(out);
-
-        // Store output for slew rate
-        lastOut = out;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - counts < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Left sweep turn backwards (for token)
-void autoSweepLB(float target) {
-    PID basePID(KP_SWEEP);
-
-    bool done = false;
-    float out, lastOut = 0;
-    float counts;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        counts = leftEnc.Counts();
-
-        // Position PID
-        out = basePID.calculate(target, counts);
-
-        // Slew rate limit
-        if(out - lastOut > MAX_STEP) {
-            out = lastOut + MAX_STEP;
-        }
-        else if(out - lastOut < -MAX_STEP) {
-            out = lastOut - MAX_STEP;
-        }
-
-        // Make sure output is at least minimum speed (prevent division by 0 too)
-        if(out != 0) {
-            if(fabs(out) < MIN_SPEED_SWEEP) {
-                out = MIN_SPEED_SWEEP * out / fabs(out);
-            }
-            else if(fabs(out) > 25) {
-                out = 25 * out / fabs(out);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(out);
-
-        // Store output for slew rate
-        lastOut = out;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - counts < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Slow forward (for foosball)
-void autoDriveFSlow(float target) {
-    PID basePID(KP_DRIVE), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-    float startTime = TimeNow();
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < 15) {
-                outL = 15 * outL / fabs(outL);
-            }
-            else if(fabs(outL) > 30) {
-                outL = 30 * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < 15) {
-                outR = 15 * outR / fabs(outR);
-            }
-            else if(fabs(outR) > 30) {
-                outR = 30 * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(-outL);
-        rightBase.SetPercent(outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if((target - avgEnc < 0) || (TimeNow() - startTime) > 1.5) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Slow backward (for token)
-void autoDriveBSlow(float target) {
-    PID basePID(KP_DRIVE), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED) {
-                outL = MIN_SPEED * outL / fabs(outL);
-            }
-            else if(fabs(outL) > 25) {
-                outL = 25 * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED) {
-                outR = MIN_SPEED * outR / fabs(outR);
-            }
-            else if(fabs(outR) > 25) {
-                outR = 25 * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(outL);
-        rightBase.SetPercent(-outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
-}
-
-// Fast backward (for token)
-void autoDriveBFast(float target) {
-    PID basePID(KP_DRIVE), driftPID(KP_DRIFT);
-
-    bool done = false;
-    float driveOut, driftOut;
-    float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc;
-
-    target *= TICKS_PER_INCH;
-
-    // Consider allowing for accumulating error
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-
-    while(!done) {
-        // Update average distance
-        avgEnc = rightEnc.Counts();
-
-        // Position PID
-        driveOut = basePID.calculate(target, avgEnc);
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut + driftOut;
-        outR = driveOut - driftOut;
-
-        // Slew rate limit
-        if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + MAX_STEP;
-        }
-        else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - MAX_STEP;
-        }
-
-        if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + MAX_STEP;
-        }
-        else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - MAX_STEP;
-        }
-
-        // Make sure output is between minimum and maximum speed (prevent division by 0 too)
-        if(outL != 0) {
-            if(fabs(outL) < MIN_SPEED) {
-                outL = MIN_SPEED * outL / fabs(outL);
-            }
-            else if(fabs(outL) > 90) {
-                outL = 90 * outL / fabs(outL);
-            }
-        }
-        if(outR != 0) {
-            if(fabs(outR) < MIN_SPEED) {
-                outR = MIN_SPEED * outR / fabs(outR);
-            }
-            else if(fabs(outR) > 90) {
-                outR = 90 * outR / fabs(outR);
-            }
-        }
-
-        // Set motors to output
-        leftBase.SetPercent(outL);
-        rightBase.SetPercent(-outR);
-
-        // Store output for slew rate
-        lastOutL = outL;
-        lastOutR = outR;
-
-        // Sleep for set time
-        Sleep(LOOP_TIME);
-
-        if(target - avgEnc < 0) {
-            done = true;
-        }
-    }
-
-    // Stop motors
-    leftBase.SetPercent(0);
-    rightBase.SetPercent(0);
+    LCD.WriteRC(recorder.battery(), 0 , 12);
+    LCD.WriteRC("       ", 1, 12);
+    LCD.WriteRC(battery.scale(), 1, 12);
 }
 
 // Sets base at specified power
 void setBase(int power) {
-    leftBase.SetPercent(-power);
-    rightBase.SetPercent(power);
+    setLeft(-power);
+    setRight(power);
 }
 
 // Sets each side of base at specified powers
 void setBaseOff(int powerL, int powerR) {
-    leftBase.SetPercent(-powerL);
-    rightBase.SetPercent(powerR);
+    setLeft(-powerL);
+    setRight(powerR);
 }
 
 // Sets base to turn at specified power
 void setTurn(int power) {
-    leftBase.SetPercent(-power);
-    rightBase.SetPercent(-power);
+    setLeft(-power);
+    setRight(-power);
+}
+
+// Sets each side of base to a velocity (in/s, positive forward) using the motor models
+void setBaseVelocity(float velocityL, float velocityR) {
+    // Left motor is mounted reversed
+    setLeft(feedforward(LEFT_MODEL, -velocityL, 0));
+    setRight(feedforward(RIGHT_MODEL, velocityR, 0));
 }
 
 // Forward/backward, specified power and time
 void timeDrive(int power, int time) {
     setBase(power);
-    Sleep(time);
+    scheduler.wait(time / 1000.0);
     setBase(0);
 }
 
 // Turn, specified power and time
 void timeTurn(int power, int time) {
     setBaseOff(-power, power);
-    Sleep(time);
+    scheduler.wait(time / 1000.0);
     setBase(0);
 }
 
@@ -942,122 +180,171 @@ void slowForward(float target) {
     // Convert target to ticks
     target *= TICKS_PER_INCH;
 
-    // Reset encoder counts
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-    Sleep(25);
+    // Encoder count at start
+    int start = leftEnc.Counts();
 
     // Set base to low forward speed
     setBase(20);
 
     // Continue until left encoder goes over target value
-    while (leftEnc.Counts() < target) {
-        Sleep(10);
+    // Polled, QuadEncoder's ISR thresholds need two channels per wheel and its port ISRs
+    // stop the FEHIO DigitalEncoders these single channel encoders use
+    while (leftEnc.Counts() - start < target) {
+        scheduler.wait(0.010);
     }
 
     // Stop base
     setBase(0);
 
-    // Sleep for .25 seconds
-    Sleep(250);
+    // Wait for .25 seconds
+    scheduler.wait(0.25);
 }
 
-// RPS heading correction (270 to 90 degrees)
+// RPS heading correction, any target
 void setAngle(float theta) {
-    bool done = false;
-
     // Offset based on course's zero degrees
-    float target = theta - zeroDegrees;
+    HeadingController::turnTo(theta - zeroDegrees);
+}
+
+// Return color of light
+int findColor() {
+    if(cds.Value() > NO_LIGHT_THRESHOLD) {
+        return NO_LIGHT;
+    }
+    else if(cds.Value() > BLUE_LIGHT_THRESHOLD) {
+        return BLUE_LIGHT;
+    }
+    else {
+        return RED_LIGHT;
+    }
+}
 
-    while (!done) {
-        // Find error
-        float error = RPS.Heading() - target;
+// Token movement
+const Segment TOKEN_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_B_SLOW, 4.3 },
+    { ROUTE_MOVE, SWEEP_LB, 5.4 },
+    { ROUTE_MOVE, DRIVE_B_FAST, 12 }
+};
 
-        // Zero crossing correction [270, 90] -> [-90, 90]
-        if (error > 180) {
-            error -= 360;
-        }
+// Move to DDR light
+const Segment DDR_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_F, 11.75 },
+    { ROUTE_ALIGN, 0, 176 },
+    { ROUTE_MOVE, TURN_L, 5.2 },
+    { ROUTE_MOVE, DRIVE_F, 15 }
+};
 
-        // Check if error is within epsilon
-        if (fabs(error) < EPSILON) {
-            done = true;
-        }
-        else {
-            // Check direction and make correction based on that
-            if (error > 0) {
-                setTurn(20);
-            }
-            else {
-                setTurn(-20);
-            }
+// Score red DDR button
+const Segment DDR_RED_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_B, 6.5 },
+    { ROUTE_MOVE, SWEEP_R, 11.1 },
+    { ROUTE_TIME, -20, 5750 },
+    { ROUTE_MOVE, DRIVE_F, 1 },
+    { ROUTE_MOVE, TURN_R, 3 },
+    { ROUTE_MOVE, DRIVE_F, 5 },
+    { ROUTE_MOVE, SWEEP_R, 6.1 }
+};
 
-            Sleep(25);
+// Score blue DDR button
+const Segment DDR_BLUE_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_B, 1.5 },
+    { ROUTE_MOVE, SWEEP_R, 11.1 },
+    { ROUTE_TIME, -20, 5750 },
+    { ROUTE_MOVE, DRIVE_F, 7.2 }
+};
 
-            setTurn(0);
-        }
+// Move to foosball (after offset correction)
+const Segment FOOSBALL_ROUTE[] = {
+    { ROUTE_MOVE, TURN_L, 1.8 },
+    { ROUTE_SLOW, 0, 8.45 },
+    { ROUTE_MOVE, TURN_L, 2.98 }
+};
 
-        Sleep(100);
-    }
-}
+// Move to lever
+const Segment LEVER_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_F, 2.5 },
+    { ROUTE_MOVE, SWEEP_R, 6.5 },
+    { ROUTE_MOVE, DRIVE_F, 1.9 }
+};
 
-// RPS heading correction (90 to 270 degrees)
-void setAngle180(float theta) {
-    bool done = false;
+// Score lever
+const Segment SCORE_LEVER_ROUTE[] = {
+    { ROUTE_SERVO, ARM_DOWN_POSITION, 250 },
+    { ROUTE_SERVO, ARM_UP_POSITION, 0 }
+};
 
-    // Offset based on course's zero degrees
-    float target = theta - zeroDegrees;
-    while (!done) {
-        // Find error
-        float error = RPS.Heading() - target;
-
-        // Check if error is within epsilon
-        if (fabs(error) < EPSILON) {
-            done = true;
-        }
-        else {
-            // Check direction and make correction based on that
-            if (error > 0) {
-                setTurn(15);
-            }
-            else {
-                setTurn(-15);
-            }
+// Move to ramp with bump
+const Segment RAMP_ROUTE[] = {
+    { ROUTE_MOVE, DRIVE_F, 3 },
+    { ROUTE_MOVE, SWEEP_R, 4 },
+    { ROUTE_MOVE, DRIVE_F, 12 },
+    { ROUTE_ALIGN, 0, 180 },
+    { ROUTE_TIME, 15, 1250 }
+};
+
+// Move down ramp to final button
+const Segment DOWN_RAMP_ROUTE[] = {
+    { ROUTE_TIME, 50, 500 },
+    { ROUTE_TIME, 80, 2000 }
+};
+
+// All routes, for checking before the run
+struct Route {
+    const char *name;
+    const Segment *segments;
+    int length;
+};
+
+const Route ROUTES[] = {
+    { "Token", TOKEN_ROUTE, ROUTE_LENGTH(TOKEN_ROUTE) },
+    { "DDR", DDR_ROUTE, ROUTE_LENGTH(DDR_ROUTE) },
+    { "Red", DDR_RED_ROUTE, ROUTE_LENGTH(DDR_RED_ROUTE) },
+    { "Blue", DDR_BLUE_ROUTE, ROUTE_LENGTH(DDR_BLUE_ROUTE) },
+    { "Foosball", FOOSBALL_ROUTE, ROUTE_LENGTH(FOOSBALL_ROUTE) },
+    { "Lever", LEVER_ROUTE, ROUTE_LENGTH(LEVER_ROUTE) },
+    { "Score lever", SCORE_LEVER_ROUTE, ROUTE_LENGTH(SCORE_LEVER_ROUTE) },
+    { "Ramp", RAMP_ROUTE, ROUTE_LENGTH(RAMP_ROUTE) },
+    { "Down ramp", DOWN_RAMP_ROUTE, ROUTE_LENGTH(DOWN_RAMP_ROUTE) }
+};
+
+// Checks every route and shows estimated distance and time
+// Returns false if a route has a bad segment
+bool checkRoutes() {
+    float distance = 0, time = 0;
+    bool ok = true;
 
-            Sleep(25);
+    for (int i = 0; i < (int)ROUTE_LENGTH(ROUTES); i++) {
+        const Route &r = ROUTES[i];
+        int bad = validateRoute(r.segments, r.length);
 
-            setTurn(0);
+        if (bad >= 0) {
+            LCD.Write("Bad route: ");
+            LCD.Write(r.name);
+            LCD.Write(" ");
+            LCD.WriteLine(bad);
+            ok = false;
         }
 
-        Sleep(100);
+        distance += routeDistance(r.segments, r.length);
+        time += routeTime(r.segments, r.length);
     }
-}
 
-// Return color of light
-int findColor() {
-    if(cds.Value() > NO_LIGHT_THRESHOLD) {
-        return NO_LIGHT;
-    }
-    else if(cds.Value() > BLUE_LIGHT_THRESHOLD) {
-        return BLUE_LIGHT;
-    }
-    else {
-        return RED_LIGHT;
-    }
+    LCD.Write("Route in: ");
+    LCD.WriteLine(distance);
+    LCD.Write("Route s: ");
+    LCD.WriteLine(time);
+
+    return ok;
 }
 
 // Token movement
 void moveToToken() {
-    autoDriveBSlow(4.3);
-    autoSweepLB(5.4);
-    autoDriveBFast(12);
+    runRoute(TOKEN_ROUTE, ROUTE_LENGTH(TOKEN_ROUTE));
 }
 
 // Move to DDR light
 void moveToDDR() {
-    autoDriveF(11.75);
-    setAngle180(176);
-    autoTurnL(5.2);
-    autoDriveF(15);
+    runRoute(DDR_ROUTE, ROUTE_LENGTH(DDR_ROUTE));
 }
 
 // Read and score DDR button
@@ -1065,21 +352,12 @@ void scoreDDR() {
     switch(findColor()) {
         case RED_LIGHT:
             LCD.WriteLine("I READ RED");
-            autoDriveB(6.5);
-            autoSweepR(11.1);
-            timeDrive(-20, 5750);
-            autoDriveF(1);
-            autoTurnR(3);
-            autoDriveF(5);
-            autoSweepR(6.1);
+            runRoute(DDR_RED_ROUTE, ROUTE_LENGTH(DDR_RED_ROUTE));
         break;
         case BLUE_LIGHT:
             LCD.WriteLine("Boo blue");
         default:
-            autoDriveB(1.5);
-            autoSweepR(11.1);
-            timeDrive(-20, 5750);
-            autoDriveF(7.2);
+            runRoute(DDR_BLUE_ROUTE, ROUTE_LENGTH(DDR_BLUE_ROUTE));
         break;
     }
 }
@@ -1090,37 +368,34 @@ void upRamp() {
     setAngle(0);
 
     // Go slow for 0.5 seconds
-    leftBase.SetPercent(-50);
-    rightBase.SetPercent(50);
-    Sleep(500);
-
-    // Climb ramp at high power while adjusting based on heading (simple P)
-    int leftPower = -70, rightPower = 90;
-    float headingAdj = 0;
-    long startTime = TimeNowMSec();
+    setBaseVelocity(RAMP_APPROACH_SPEED, RAMP_APPROACH_SPEED);
+    scheduler.wait(0.5);
+
+    // Climb ramp at same speed on both sides while adjusting based on heading (simple P)
+    // Motor models make up for the difference between the motors
+    long startTime = recorder.timeNowMSec();
     // Continue for 2 seconds
-    while (TimeNowMSec() - startTime < 2000) {
-        headingAdj = RPS.Heading() * 4;
+    while (recorder.timeNowMSec() - startTime < 2000) {
+        float headingAdj = KP_RAMP * HeadingController::error(-zeroDegrees, ekf.heading());
 
-        leftPower -= headingAdj;
-        rightPower -= headingAdj;
+        setBaseVelocity(RAMP_CLIMB_SPEED - headingAdj, RAMP_CLIMB_SPEED + headingAdj);
 
-        Sleep(50);
+        scheduler.wait(0.050);
     }
 
     // Continue forward for 0.5 seconds to prevent tip
     setBase(25);
-    Sleep(500);
+    scheduler.wait(0.5);
 
     // Back up until in RPS range
     setBase(-25);
 
-    while (RPS.Y() < 0) {
-        Sleep(50);
+    while (rps.get().y < 0) {
+        scheduler.wait(0.050);
     }
 
-    while (RPS.Y() < 0) {
-        Sleep(50);
+    while (rps.get().y < 0) {
+        scheduler.wait(0.050);
     }
 
     setBase(0);
@@ -1132,51 +407,47 @@ void upRamp() {
     setBase(-15);
 
     // Find x offset while doing so
-    xPos = RPS.X() - RPS_TARGET_X;
+    xPos = rps.get().x - RPS_TARGET_X;
 
     // Recheck in case of RPS error
     while (xPos < -RPS_TARGET_X) {
         setBase(-15);
-        Sleep(50);
+        scheduler.wait(0.050);
         setBase(0);
-        Sleep(50);
-        xPos = RPS.X() - RPS_TARGET_X;
+        scheduler.wait(0.050);
+        xPos = rps.get().x - RPS_TARGET_X;
     }
 
-    Sleep(500);
+    scheduler.wait(0.5);
     setBase(0);
 
     // Find ending y position
-    yPos = RPS.Y() - RPS_TARGET_Y;
+    yPos = rps.get().y - RPS_TARGET_Y;
     LCD.WriteLine(yPos);
 
     // Recheck in case of RPS error
     while (yPos < -RPS_TARGET_Y) {
         setBase(-15);
-        Sleep(50);
+        scheduler.wait(0.050);
         setBase(0);
-        Sleep(50);
-        yPos = RPS.Y() - RPS_TARGET_Y;
+        scheduler.wait(0.050);
+        yPos = rps.get().y - RPS_TARGET_Y;
     }
 }
 
 // Move to foosball
 void moveToFoosball(float offsetY) {
     slowForward(5.5 - offsetY);
-    autoTurnL(1.8);
-    slowForward(8.45);
-    autoTurnL(2.98);
+    runRoute(FOOSBALL_ROUTE, ROUTE_LENGTH(FOOSBALL_ROUTE));
 }
 
 // Correct x offset
 void correctOffsetX(float offsetX) {
     if (offsetX > 0) {
         autoDriveF(offsetX);
-        Sleep(25);
     }
     else {
         autoDriveB(-offsetX);
-        Sleep(25);
     }
 }
 
@@ -1186,83 +457,95 @@ void scoreFoosball() {
 
     // Move foosball
     armServo.SetDegree(armDown);
-    Sleep(250);
+    scheduler.wait(0.25);
+    int startL = leftEnc.Counts(), startR = rightEnc.Counts();
     autoDriveFSlow(9.85);
 
-    // Store encoder counts
-    endL = leftEnc.Counts();
-    endR = rightEnc.Counts();
+    // Store encoder counts for the move
+    endL = leftEnc.Counts() - startL;
+    endR = rightEnc.Counts() - startR;
 
     // Raise arm
     armServo.SetDegree(armUp);
-    Sleep(250);
-
-    // Reset encoders
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
-    Sleep(25);
+    scheduler.wait(0.25);
 
-    // Correct encoder offset
+    // Correct encoder offset (polled like slowForward)
     if (endL > endR) {
-        leftBase.SetPercent(MIN_SPEED_SWEEP);
-        while (leftEnc.Counts() < endL - endR) {
-            Sleep(10);
+        int target = leftEnc.Counts() + endL - endR;
+        setLeft(MIN_SPEED_SWEEP);
+        while (leftEnc.Counts() < target) {
+            scheduler.wait(0.010);
         }
-        leftBase.SetPercent(0);
-        endL -= leftEnc.Counts();
+        setLeft(0);
     }
     else {
-        rightBase.SetPercent(-MIN_SPEED_SWEEP);
-        while (rightEnc.Counts() < endR - endL) {
-            Sleep(10);
+        int target = rightEnc.Counts() + endR - endL;
+        setRight(-MIN_SPEED_SWEEP);
+        while (rightEnc.Counts() < target) {
+            scheduler.wait(0.010);
         }
-        rightBase.SetPercent(0);
-        endR -= rightEnc.Counts();
+        setRight(0);
     }
-
-    // Reset encoders again
-    leftEnc.ResetCounts();
-    rightEnc.ResetCounts();
 }
 
 // Move to lever
 void moveToLever() {
-    autoDriveF(2.5);
-    autoSweepR(6.5);
-    autoDriveF(1.9);
+    runRoute(LEVER_ROUTE, ROUTE_LENGTH(LEVER_ROUTE));
 }
 
 // Score lever
 void scoreLever() {
-    armServo.SetDegree(armDown);
-    Sleep(250);
-    armServo.SetDegree(armUp);
+    runRoute(SCORE_LEVER_ROUTE, ROUTE_LENGTH(SCORE_LEVER_ROUTE));
 }
 
 // Move to ramp with bump
 void moveToRamp() {
-    autoDriveF(3);
-    autoSweepR(4);
-    autoDriveF(12);
-    setAngle180(180);
-    timeDrive(15, 1250);
+    runRoute(RAMP_ROUTE, ROUTE_LENGTH(RAMP_ROUTE));
+}
+
+// Time the run started (s)
+float runStart;
+
+// True once the run has gone on longer than RUN_TIME_LIMIT
+bool runOver() {
+    return recorder.timeNow() - runStart > RUN_TIME_LIMIT;
+}
+
+// Stops motors and closes the log
+void endRun() {
+    setBase(0);
+    recorder.stop();
+}
+
+// Run timeout task
+// Closes the log if the run is stuck somewhere (motors keep going, the log is complete)
+void runTimeout() {
+    if (runOver()) {
+        recorder.stop();
+    }
 }
 
 // Move down ramp and hit final button
 void downRamp() {
     // Move down ramp to final button
-    timeDrive(50, 500);
-    timeDrive(80, 2000);
+    runRoute(DOWN_RAMP_ROUTE, ROUTE_LENGTH(DOWN_RAMP_ROUTE));
 
-    // Repeatedly back up and ram something
-    while (1) {
+    // Repeatedly back up and ram something until the screen is touched
+    // or the run time limit is up
+    float x, y;
+    while (!recorder.touch(&x, &y) && !runOver()) {
         timeDrive(-50, 500);
         timeTurn(-20, 250);
         timeDrive(50, 1000);
     }
+
+    endRun();
 }
 
 int main(void) {
+    // Start log (only when recording reads)
+    recorder.start();
+
     // Servo positions
     armServo.SetMin(738);
     armServo.SetMax(2500);
@@ -1286,12 +569,12 @@ int main(void) {
     bool moveOn = false, setupRPS = false;
     while (!moveOn) {
         // Determine touch position
-        if (LCD.Touch(&x, &y)) {
+        if (recorder.touch(&x, &y)) {
 
             // Servo calibration (robot tilted)
-            if (Accel.Y() > 0.25 || Accel.Y() < -0.25) {
+            if (recorder.accelY() > 0.25 || recorder.accelY() < -0.25) {
                 // Until untilted
-                while (Accel.Y() > 0.25) {
+                while (recorder.accelY() > 0.25) {
                     adjustServo();
                 }
             }
@@ -1316,14 +599,16 @@ int main(void) {
             bool done = false;
             while(!done) {
                 // Display RPS coordinates
+                rps.update();
                 displayRPS();
 
-                // If touched, store position and end calibration
-                if (LCD.Touch(&x, &y)) {
+                // If touched, store position and end calibration (all from one packet)
+                if (recorder.touch(&x, &y)) {
+                    const RPSSnapshot &packet = rps.get();
                     done = true;
-                    postRampX = RPS.X() - RPS_SETUP_X;
-                    postRampY = RPS.Y() - RPS_SETUP_Y;
-                    zeroDegrees = RPS.Heading() - 180;
+                    postRampX = packet.x - RPS_SETUP_X;
+                    postRampY = packet.y - RPS_SETUP_Y;
+                    zeroDegrees = packet.heading - 180;
                 }
 
                 Sleep(100);
@@ -1332,11 +617,13 @@ int main(void) {
         }
 
         // Wait for release
-        while (LCD.Touch(&x, &y)) {
+        while (recorder.touch(&x, &y)) {
             Sleep(10);
         }
 
         // Update screen
+        rps.update();
+        battery.update();
         displayRPS();
         displayOther(postRampX, postRampY);
         Sleep(50);
@@ -1347,12 +634,26 @@ int main(void) {
     LCD.SetFontColor(FEHLCD::White);
     LCD.WriteRC("Ready :P", 13, 0);
 
+    // Check routes before starting
+    checkRoutes();
+
+    // Start battery monitor, RPS cache, odometry and pose estimator
+    battery.start();
+    rps.start();
+    odometry.start();
+    ekf.start();
+
     // Wait for start light or for 30 seconds
-    float startTime = TimeNow();
-    while((TimeNow() - startTime < 30) && (cds.Value() > NO_LIGHT_THRESHOLD)) {
-        Sleep(50);
+    // Tasks keep running so they don't start the course with thousands of overruns
+    float startTime = recorder.timeNow();
+    while((recorder.timeNow() - startTime < 30) && (cds.Value() > NO_LIGHT_THRESHOLD)) {
+        scheduler.wait(0.050);
     }
 
+    // Run starts, log is closed at the end or after RUN_TIME_LIMIT
+    runStart = recorder.timeNow();
+    scheduler.addTask(runTimeout, 1);
+
     // Move to token and score
     moveToToken();
 
@@ -1385,4 +686,6 @@ int main(void) {
 
     // Move down ramp
     downRamp();
+
+    return 0;
 }
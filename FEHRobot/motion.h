@@ -0,0 +1,314 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include <FEHIO.h>
+#include <FEHUtility.h>
+#include <FEHMotor.h>
+#include <cmath>
+#include "plib.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "odometry.h"
+#include "feedforward.h"
+
+// Minimum speeds (only used to creep to the target once the profile is over)
+#define MIN_SPEED 10
+#define MIN_SPEED_TURNING 16
+#define MIN_SPEED_SWEEP 18
+
+// Maximum movement speed
+#define MAX_SPEED 60
+
+// Motion profile limits (in/s^2, in/s^3, 0 jerk for trapezoidal)
+#define MAX_ACCEL 30
+#define MAX_JERK 150
+
+// Nominal motor percent per in/s, converts speed limits to profile velocities
+// (outputs use the per motor model in feedforward.h)
+#define KV 3.0
+
+// kP for movements (simulator/tune builds with its own)
+#ifndef KP_DRIVE
+#define KP_DRIVE 0.4
+#endif
+#ifndef KP_TURN
+#define KP_TURN 0.4
+#endif
+#ifndef KP_SWEEP
+#define KP_SWEEP 0.6
+#endif
+#ifndef KP_DRIFT
+#define KP_DRIFT 0.5
+#endif
+
+// State of a move in progress
+// target is desired encoder count
+// lastOutL, lastOutR store last output
+// exitSpeed is the speed the profile ends at (motor percent), the next move enters at it when blending
+// startL, startR are encoder counts at start (encoders are never reset)
+// startTime is in microseconds, used for profile and timeouts
+// profile gives position and velocity setpoints
+struct MotionState {
+    float target;
+    int startL, startR;
+    float lastOutL, lastOutR;
+    float exitSpeed;
+    unsigned long startTime;
+    MotionProfile profile;
+};
+
+// Converts motor percent to velocity in ticks/s
+float percentToVelocity(float percent) {
+    return percent / KV * TICKS_PER_INCH;
+}
+
+// Motion engine
+// LEFT, RIGHT are motor signs for each side of the base (0 if that side is not driven)
+// MIN, MAX are minimum and maximum speed, MAX also sets the profile's cruise velocity
+// TIMEOUT is the time limit in ms (0 for none)
+// Both sides driven in opposite directions is a drive, same direction is a turn, one side is a sweep
+// Drive and turn use the right encoder and drift PID, sweep uses the encoder of its side
+// Everything depending on the template parameters is resolved at compile time
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+class Motion {
+    public:
+        enum {
+            LEFT_SIGN = LEFT,
+            RIGHT_SIGN = RIGHT,
+            MIN_OUT = MIN,
+            MAX_OUT = MAX
+        };
+        static void begin(MotionState &s, float target, float entrySpeed = 0, float exitSpeed = 0);
+        static bool step(MotionState &s);
+        static void run(float target);
+        static float kP();
+    private:
+        static MotionState state;
+        static bool done;
+        static void task();
+        static bool isDone();
+        static float counts(MotionState &s, EncoderCounts &enc);
+        static float limit(float out, bool creep);
+};
+
+// Motion function kP
+// Picks constant based on type of movement
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+float Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::kP() {
+    if (LEFT == 0 || RIGHT == 0) {
+        return KP_SWEEP;
+    }
+    else if (LEFT == RIGHT) {
+        return KP_TURN;
+    }
+    else {
+        return KP_DRIVE;
+    }
+}
+
+// Motion function counts
+// Returns encoder counts since start of move used for position
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+float Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::counts(MotionState &s, EncoderCounts &enc) {
+    if (RIGHT == 0) {
+        return enc.left - s.startL;
+    }
+    else {
+        return enc.right - s.startR;
+    }
+}
+
+// Motion function limit
+// Make sure output is below maximum speed (prevent division by 0 too)
+// Minimum speed only applies when creeping to the target after the profile,
+// before that feedforward already covers static friction
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+float Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::limit(float out, bool creep) {
+    if(out != 0) {
+        if(creep && fabs(out) < MIN) {
+            out = MIN * out / fabs(out);
+        }
+        else if(fabs(out) > MAX) {
+            out = MAX * out / fabs(out);
+        }
+    }
+
+    return out;
+}
+
+// Motion function begin
+// Converts target to ticks, stores start counts and generates profile
+// entrySpeed, exitSpeed are motor percent at start and end (for blending moves)
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+void Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::begin(MotionState &s, float target, float entrySpeed, float exitSpeed) {
+    s.target = target * TICKS_PER_INCH;
+    s.lastOutL = 0;
+    s.lastOutR = 0;
+    s.exitSpeed = exitSpeed;
+    EncoderCounts enc = readEncoders();
+    s.startL = enc.left;
+    s.startR = enc.right;
+    s.startTime = timeMicros();
+
+    s.profile.generate(s.target, percentToVelocity(MAX), MAX_ACCEL * TICKS_PER_INCH, MAX_JERK * TICKS_PER_INCH,
+                       percentToVelocity(entrySpeed), percentToVelocity(exitSpeed));
+}
+
+// Motion function step
+// One iteration of profile tracking (position PID plus motor model feedforward) and drift PID
+// Returns true once at location (or timed out)
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+bool Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::step(MotionState &s) {
+    PID basePID(kP()), driftPID(KP_DRIFT);
+
+    float driveOut, driftOut = 0;
+    float outL, outR;
+
+    // Time since start of move
+    unsigned long elapsed = timeMicros() - s.startTime;
+    float t = elapsed / 1000000.0;
+
+    // Update distance
+    // Encoders are read once, position and drift use the same counts
+    EncoderCounts enc = readEncoders();
+    float avgEnc = counts(s, enc);
+
+    // Position PID on profile setpoint
+    driveOut = basePID.calculate(s.profile.position(t), avgEnc);
+
+    // Feedforward on profile velocity and acceleration (in/s, in/s^2)
+    // Model works in each motor's direction, LEFT and RIGHT convert to and from it
+    float velocity = s.profile.velocity(t) / TICKS_PER_INCH;
+    float acceleration = s.profile.acceleration(t) / TICKS_PER_INCH;
+    float forwardL = LEFT * feedforward(LEFT_MODEL, LEFT * velocity, LEFT * acceleration);
+    float forwardR = RIGHT * feedforward(RIGHT_MODEL, RIGHT * velocity, RIGHT * acceleration);
+    bool creep = t > s.profile.duration();
+
+    // Drift PID (only when both sides are driven)
+    if (LEFT != 0 && RIGHT != 0) {
+        driftOut = driftPID.calculate(0, (enc.left - s.startL) - (enc.right - s.startR));
+    }
+
+    // Calculate motor outputs
+    // Limit driveOut contribution so driftOut can have affect it?
+    outL = limit(forwardL + driveOut + driftOut, creep);
+    outR = limit(forwardR + driveOut - driftOut, creep);
+
+    // Set motors to output
+    if (LEFT != 0) {
+        setLeft(LEFT * outL);
+    }
+    if (RIGHT != 0) {
+        setRight(RIGHT * outR);
+    }
+
+    // Store output for blending
+    s.lastOutL = outL;
+    s.lastOutR = outR;
+
+    if (TIMEOUT > 0 && elapsed > TIMEOUT * 1000UL) {
+        return true;
+    }
+
+    return s.target - avgEnc < 0;
+}
+
+// Motion function task
+// Control task registered with the scheduler
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+void Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::task() {
+    done = step(state);
+}
+
+// Motion function isDone
+// Tells the scheduler when to stop
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+bool Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::isDone() {
+    return done;
+}
+
+// Motion function run
+// Blocking move: steps at CONTROL_RATE until done, then stops motors
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+void Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::run(float target) {
+    begin(state, target);
+    done = false;
+
+    int id = scheduler.addTask(task, CONTROL_RATE);
+    scheduler.run(isDone);
+    scheduler.removeTask(id);
+
+    // Stop motors
+    setLeft(0);
+    setRight(0);
+}
+
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+MotionState Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::state;
+
+template <int LEFT, int RIGHT, int MIN, int MAX, int TIMEOUT>
+bool Motion<LEFT, RIGHT, MIN, MAX, TIMEOUT>::done;
+
+// Movement types
+typedef Motion<-1, 1, MIN_SPEED, MAX_SPEED, 0> DriveF;
+typedef Motion<1, -1, MIN_SPEED, MAX_SPEED, 0> DriveB;
+typedef Motion<1, 1, MIN_SPEED_TURNING, MAX_SPEED, 0> TurnL;
+typedef Motion<-1, -1, MIN_SPEED_TURNING, MAX_SPEED, 0> TurnR;
+typedef Motion<-1, 0, MIN_SPEED_SWEEP, MAX_SPEED, 0> SweepL;
+typedef Motion<0, 1, MIN_SPEED_SWEEP, MAX_SPEED, 0> SweepR;
+typedef Motion<1, 0, MIN_SPEED_SWEEP, 25, 0> SweepLB;
+typedef Motion<-1, 1, 15, 30, 1500> DriveFSlow;
+typedef Motion<1, -1, MIN_SPEED, 25, 0> DriveBSlow;
+typedef Motion<1, -1, MIN_SPEED, 90, 0> DriveBFast;
+
+// Forward
+void autoDriveF(float target) {
+    DriveF::run(target);
+}
+
+// Backward
+void autoDriveB(float target) {
+    DriveB::run(target);
+}
+
+// Left turn
+void autoTurnL(float target) {
+    TurnL::run(target);
+}
+
+// Right turn
+void autoTurnR(float target) {
+    TurnR::run(target);
+}
+
+// Left sweep turn
+void autoSweepL(float target) {
+    SweepL::run(target);
+}
+
+// Right sweep turn
+void autoSweepR(float target) {
+    SweepR::run(target);
+}
+
+// Left sweep turn backwards (for token)
+void autoSweepLB(float target) {
+    SweepLB::run(target);
+}
+
+// Slow forward (for foosball)
+void autoDriveFSlow(float target) {
+    DriveFSlow::run(target);
+}
+
+// Slow backward (for token)
+void autoDriveBSlow(float target) {
+    DriveBSlow::run(target);
+}
+
+// Fast backward (for token)
+void autoDriveBFast(float target) {
+    DriveBFast::run(target);
+}
+
+#endif // MOTION_H
@@ -0,0 +1,214 @@
+#ifndef MOTIONQUEUE_H
+#define MOTIONQUEUE_H
+
+#include "motion.h"
+#include "scheduler.h"
+
+// Maximum number of queued moves
+#define QUEUE_SIZE 16
+
+// Move types that can be queued
+enum {
+    DRIVE_F,
+    DRIVE_B,
+    TURN_L,
+    TURN_R,
+    SWEEP_L,
+    SWEEP_R,
+    SWEEP_LB,
+    DRIVE_F_SLOW,
+    DRIVE_B_SLOW,
+    DRIVE_B_FAST
+};
+
+// Table entry for a move type
+// begin, step are the motion engine functions
+// left, right are motor signs, max is maximum speed
+struct MoveType {
+    void (*begin)(MotionState &s, float target, float entrySpeed, float exitSpeed);
+    bool (*step)(MotionState &s);
+    int left, right, max;
+};
+
+// Move types in the same order as the enum
+const MoveType moveTypes[] = {
+    { DriveF::begin, DriveF::step, DriveF::LEFT_SIGN, DriveF::RIGHT_SIGN, DriveF::MAX_OUT },
+    { DriveB::begin, DriveB::step, DriveB::LEFT_SIGN, DriveB::RIGHT_SIGN, DriveB::MAX_OUT },
+    { TurnL::begin, TurnL::step, TurnL::LEFT_SIGN, TurnL::RIGHT_SIGN, TurnL::MAX_OUT },
+    { TurnR::begin, TurnR::step, TurnR::LEFT_SIGN, TurnR::RIGHT_SIGN, TurnR::MAX_OUT },
+    { SweepL::begin, SweepL::step, SweepL::LEFT_SIGN, SweepL::RIGHT_SIGN, SweepL::MAX_OUT },
+    { SweepR::begin, SweepR::step, SweepR::LEFT_SIGN, SweepR::RIGHT_SIGN, SweepR::MAX_OUT },
+    { SweepLB::begin, SweepLB::step, SweepLB::LEFT_SIGN, SweepLB::RIGHT_SIGN, SweepLB::MAX_OUT },
+    { DriveFSlow::begin, DriveFSlow::step, DriveFSlow::LEFT_SIGN, DriveFSlow::RIGHT_SIGN, DriveFSlow::MAX_OUT },
+    { DriveBSlow::begin, DriveBSlow::step, DriveBSlow::LEFT_SIGN, DriveBSlow::RIGHT_SIGN, DriveBSlow::MAX_OUT },
+    { DriveBFast::begin, DriveBFast::step, DriveBFast::LEFT_SIGN, DriveBFast::RIGHT_SIGN, DriveBFast::MAX_OUT }
+};
+
+// Non-blocking motion queue
+// Moves are added with add and run by a scheduler task in order
+// Motors are not stopped between moves: the exit speed of a move becomes the
+// entry speed of the next one's profile
+// Call busy to poll, wait to block until every move is done
+class MotionQueue {
+    public:
+        MotionQueue();
+        bool add(int type, float target);
+        bool busy();
+        void wait();
+        void clear();
+    private:
+        int types[QUEUE_SIZE];
+        float targets[QUEUE_SIZE];
+        int head, count;
+        int taskId;
+        bool started;
+        MotionState state;
+        void start();
+        float exitSpeed();
+        static void task();
+        static bool idle();
+};
+
+// Declare queue
+MotionQueue motionQueue;
+
+// MotionQueue object constructor
+// Queue empty, no task registered
+MotionQueue::MotionQueue() {
+    head = 0;
+    count = 0;
+    taskId = -1;
+    started = false;
+}
+
+// MotionQueue function add
+// Adds move to the end of the queue and starts running if idle
+// Returns false if queue is full
+bool MotionQueue::add(int type, float target) {
+    if (count >= QUEUE_SIZE) {
+        return false;
+    }
+
+    int index = (head + count) % QUEUE_SIZE;
+    types[index] = type;
+    targets[index] = target;
+    count++;
+
+    if (taskId < 0) {
+        taskId = scheduler.addTask(task, CONTROL_RATE);
+    }
+
+    return true;
+}
+
+// MotionQueue function busy
+// Returns true while moves are left
+bool MotionQueue::busy() {
+    return count > 0;
+}
+
+// MotionQueue function wait
+// Runs scheduler until queue is empty
+void MotionQueue::wait() {
+    if (busy()) {
+        scheduler.run(idle);
+    }
+}
+
+// MotionQueue function clear
+// Drops remaining moves and stops motors
+void MotionQueue::clear() {
+    count = 0;
+    started = false;
+
+    scheduler.removeTask(taskId);
+    taskId = -1;
+
+    setLeft(0);
+    setRight(0);
+}
+
+// MotionQueue function start
+// Begins move at head, entering at the current speed and leaving at the speed the next move can take
+void MotionQueue::start() {
+    const MoveType &move = moveTypes[types[head]];
+
+    // Enter at the speed the previous profile ended at
+    // Its outputs can't be used, they include the motor model's kS and the PID terms
+    // exitSpeed only blends into a move that keeps every wheel turning the same way
+    float entry = 0;
+    if (started) {
+        entry = state.exitSpeed;
+    }
+
+    move.begin(state, targets[head], entry, exitSpeed());
+
+    // Stop side that isn't driven
+    if (move.left == 0) {
+        setLeft(0);
+    }
+    if (move.right == 0) {
+        setRight(0);
+    }
+
+    started = true;
+}
+
+// MotionQueue function exitSpeed
+// Speed to keep at the end of the current move so the next one starts moving
+// Only blends if every wheel of the next move keeps turning the same way,
+// and not faster than the next move can stop from within its distance
+float MotionQueue::exitSpeed() {
+    if (count < 2) {
+        return 0;
+    }
+
+    const MoveType &move = moveTypes[types[head]];
+    int next = (head + 1) % QUEUE_SIZE;
+    const MoveType &nextMove = moveTypes[types[next]];
+
+    if ((nextMove.left != 0 && nextMove.left != move.left) ||
+        (nextMove.right != 0 && nextMove.right != move.right)) {
+        return 0;
+    }
+
+    float speed = KV * sqrt(2 * MAX_ACCEL * targets[next]);
+    if (speed > nextMove.max) {
+        speed = nextMove.max;
+    }
+    if (speed > move.max) {
+        speed = move.max;
+    }
+
+    return speed;
+}
+
+// MotionQueue function task
+// Control task: steps current move and moves on to the next one when done
+void MotionQueue::task() {
+    MotionQueue &q = motionQueue;
+
+    if (!q.started) {
+        q.start();
+    }
+
+    if (moveTypes[q.types[q.head]].step(q.state)) {
+        q.head = (q.head + 1) % QUEUE_SIZE;
+        q.count--;
+
+        if (q.count > 0) {
+            q.start();
+        }
+        else {
+            q.clear();
+        }
+    }
+}
+
+// MotionQueue function idle
+// Tells the scheduler when the queue is empty
+bool MotionQueue::idle() {
+    return !motionQueue.busy();
+}
+
+#endif // MOTIONQUEUE_H
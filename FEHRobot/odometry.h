@@ -0,0 +1,171 @@
+#ifndef ODOMETRY_H
+#define ODOMETRY_H
+
+#include <FEHIO.h>
+#include <FEHMotor.h>
+#include <cmath>
+#include "scheduler.h"
+#include "battery.h"
+
+// Conversion from ticks to inches
+#define TICKS_PER_INCH 2
+
+// Distance between wheels (in), measure wheel contact to contact
+#define TRACK_WIDTH 7.5
+
+// Odometry update rate (Hz)
+#define ODOMETRY_RATE 200
+
+// Motors and encoders (declared in main.cpp)
+extern FEHMotor leftBase, rightBase;
+extern RecordedEncoder leftEnc, rightEnc;
+
+// Counts of both encoders from one read
+// DigitalEncoder counts can't be latched together, so the two are read back to back
+struct EncoderCounts {
+    int left, right;
+};
+
+// Reads each encoder once, everything in a control step uses the same values
+EncoderCounts readEncoders() {
+    EncoderCounts counts;
+    counts.left = leftEnc.Counts();
+    counts.right = rightEnc.Counts();
+    return counts;
+}
+
+// Continuous differential drive odometry
+// Encoders are never reset, counts are integrated into (x, y, heading) at ODOMETRY_RATE
+// Digital encoders don't know direction, so each wheel uses the direction it was last driven
+// x, y in inches and heading in radians, starting from (0, 0, 0) facing +x
+class Odometry {
+    public:
+        Odometry();
+        void start();
+        void update();
+        void setDirection(int left, int right);
+        float x();
+        float y();
+        float heading();
+        float leftDistance();
+        float rightDistance();
+    private:
+        int lastL, lastR;
+        int directionL, directionR;
+        float poseX, poseY, theta;
+        float distanceL, distanceR;
+        static void task();
+};
+
+// Declare odometry
+Odometry odometry;
+
+// Odometry object constructor
+// Pose at origin, wheels driven forward
+Odometry::Odometry() {
+    lastL = 0;
+    lastR = 0;
+    directionL = 1;
+    directionR = 1;
+    poseX = 0;
+    poseY = 0;
+    theta = 0;
+    distanceL = 0;
+    distanceR = 0;
+}
+
+// Odometry function start
+// Takes current counts as reference and registers update task
+void Odometry::start() {
+    EncoderCounts counts = readEncoders();
+    lastL = counts.left;
+    lastR = counts.right;
+    scheduler.addTask(task, ODOMETRY_RATE);
+}
+
+// Odometry function update
+// Integrates counts since last update (midpoint heading for the arc)
+void Odometry::update() {
+    EncoderCounts counts = readEncoders();
+    int countsL = counts.left, countsR = counts.right;
+
+    float deltaL = (float)directionL * (countsL - lastL) / TICKS_PER_INCH;
+    float deltaR = (float)directionR * (countsR - lastR) / TICKS_PER_INCH;
+    lastL = countsL;
+    lastR = countsR;
+
+    float distance = (deltaL + deltaR) / 2;
+    float deltaTheta = (deltaR - deltaL) / TRACK_WIDTH;
+
+    poseX += distance * cos(theta + deltaTheta / 2);
+    poseY += distance * sin(theta + deltaTheta / 2);
+    theta += deltaTheta;
+
+    distanceL += deltaL;
+    distanceR += deltaR;
+}
+
+// Odometry function setDirection
+// Called before a wheel changes direction so counts so far use the old one
+// 1 forward, -1 backward, 0 keeps the current direction (wheel coasting)
+void Odometry::setDirection(int left, int right) {
+    if ((left != 0 && left != directionL) || (right != 0 && right != directionR)) {
+        update();
+    }
+    if (left != 0) {
+        directionL = left;
+    }
+    if (right != 0) {
+        directionR = right;
+    }
+}
+
+// Odometry function x
+float Odometry::x() {
+    return poseX;
+}
+
+// Odometry function y
+float Odometry::y() {
+    return poseY;
+}
+
+// Odometry function heading
+float Odometry::heading() {
+    return theta;
+}
+
+// Odometry function leftDistance
+// Signed distance traveled by left wheel since start
+float Odometry::leftDistance() {
+    return distanceL;
+}
+
+// Odometry function rightDistance
+// Signed distance traveled by right wheel since start
+float Odometry::rightDistance() {
+    return distanceR;
+}
+
+// Odometry function task
+// Update task registered with the scheduler
+void Odometry::task() {
+    odometry.update();
+}
+
+// Sets left motor, keeping track of direction for odometry
+// Left motor is mounted reversed, so negative percent is forward
+// Percent is at nominal battery voltage
+void setLeft(float percent) {
+    odometry.setDirection(percent < 0 ? 1 : (percent > 0 ? -1 : 0), 0);
+    leftBase.SetPercent(battery.compensate(percent));
+}
+
+// Sets right motor, keeping track of direction for odometry
+// Percent is at nominal battery voltage
+void setRight(float percent) {
+    odometry.setDirection(0, percent > 0 ? 1 : (percent < 0 ? -1 : 0));
+    rightBase.SetPercent(battery.compensate(percent));
+}
+
+#endif // ODOMETRY_H
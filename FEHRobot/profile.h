@@ -0,0 +1,210 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cmath>
+
+using namespace std;
+
+// Motion profile generator
+// Time-optimal trapezoidal velocity profile from start velocity to end velocity
+// over a distance, limited by maximum velocity and acceleration
+// With a jerk limit the trapezoid is averaged over a window of length
+// maxAccel / maxJerk, which gives the jerk-limited S-curve (acceleration ramps
+// instead of steps) and takes exactly one window longer
+// Everything is solved once in generate, position and velocity are closed form
+class MotionProfile {
+    public:
+        MotionProfile();
+        void generate(float distance, float maxVelocity, float maxAccel, float maxJerk = 0, float startVelocity = 0, float endVelocity = 0);
+        float position(float t);
+        float velocity(float t);
+        float acceleration(float t);
+        float duration();
+        float endVelocity();
+    private:
+        float d, a, v0, vp, v1;
+        float ta, tc, td, total;
+        float window, offset;
+        float trapPosition(float t);
+        float trapVelocity(float t);
+        float trapIntegral(float t);
+};
+
+// MotionProfile object constructor
+// Empty profile that is already finished
+MotionProfile::MotionProfile() {
+    generate(0, 1, 1);
+}
+
+// MotionProfile function generate
+// Solves accelerate, cruise and decelerate phases
+// All values positive, distance in any unit and velocities/acceleration in the same unit per second
+// End velocity is lowered (or raised) if it can't be reached over the distance
+void MotionProfile::generate(float distance, float maxVelocity, float maxAccel, float maxJerk, float startVelocity, float endVelocity) {
+    a = maxAccel;
+    v0 = startVelocity < maxVelocity ? startVelocity : maxVelocity;
+    v1 = endVelocity < maxVelocity ? endVelocity : maxVelocity;
+
+    // Jerk limit as averaging window
+    window = maxJerk > 0 ? maxAccel / maxJerk : 0;
+
+    // Averaging moves start and end by half a window of each velocity, so correct the distance
+    d = distance - (v0 + v1) * window / 2;
+    if (d < 0) {
+        d = 0;
+    }
+    offset = v0 * window / 2;
+
+    // Make sure end velocity is reachable
+    if (v1 * v1 > v0 * v0 + 2 * a * d) {
+        v1 = sqrt(v0 * v0 + 2 * a * d);
+    }
+    else if (v0 * v0 - 2 * a * d > v1 * v1) {
+        v1 = sqrt(v0 * v0 - 2 * a * d);
+    }
+
+    // Peak velocity, limited by maximum velocity (cruise) or distance (triangle)
+    vp = sqrt((2 * a * d + v0 * v0 + v1 * v1) / 2);
+    if (vp > maxVelocity) {
+        vp = maxVelocity;
+    }
+    if (vp < v0) {
+        vp = v0;
+    }
+    if (vp < v1) {
+        vp = v1;
+    }
+
+    ta = (vp - v0) / a;
+    td = (vp - v1) / a;
+    float da = (vp * vp - v0 * v0) / (2 * a);
+    float dd = (vp * vp - v1 * v1) / (2 * a);
+    tc = vp > 0 ? (d - da - dd) / vp : 0;
+    if (tc < 0) {
+        tc = 0;
+    }
+
+    total = ta + tc + td;
+}
+
+// MotionProfile function trapPosition
+// Position of the trapezoid, continued at start/end velocity outside of it
+float MotionProfile::trapPosition(float t) {
+    if (t < 0) {
+        return v0 * t;
+    }
+    else if (t < ta) {
+        return v0 * t + a * t * t / 2;
+    }
+    else if (t < ta + tc) {
+        t -= ta;
+        return (v0 + vp) / 2 * ta + vp * t;
+    }
+    else if (t < total) {
+        t -= ta + tc;
+        return (v0 + vp) / 2 * ta + vp * tc + vp * t - a * t * t / 2;
+    }
+    else {
+        return d + v1 * (t - total);
+    }
+}
+
+// MotionProfile function trapIntegral
+// Integral of trapPosition from 0 to t
+float MotionProfile::trapIntegral(float t) {
+    float da = (v0 + vp) / 2 * ta;
+    float dc = vp * tc;
+
+    if (t < 0) {
+        return v0 * t * t / 2;
+    }
+
+    float sum = 0;
+    float tau = t < ta ? t : ta;
+    sum += v0 * tau * tau / 2 + a * tau * tau * tau / 6;
+    if (t <= ta) {
+        return sum;
+    }
+
+    tau = t < ta + tc ? t - ta : tc;
+    sum += da * tau + vp * tau * tau / 2;
+    if (t <= ta + tc) {
+        return sum;
+    }
+
+    tau = t < total ? t - ta - tc : td;
+    sum += (da + dc) * tau + vp * tau * tau / 2 - a * tau * tau * tau / 6;
+    if (t <= total) {
+        return sum;
+    }
+
+    tau = t - total;
+    return sum + d * tau + v1 * tau * tau / 2;
+}
+
+// MotionProfile function position
+// Setpoint position at time t (seconds since start)
+float MotionProfile::position(float t) {
+    if (window <= 0) {
+        return trapPosition(t);
+    }
+    return (trapIntegral(t) - trapIntegral(t - window)) / window + offset;
+}
+
+// MotionProfile function trapVelocity
+// Velocity of the trapezoid, start/end velocity outside of it
+float MotionProfile::trapVelocity(float t) {
+    if (t < 0) {
+        return v0;
+    }
+    else if (t < ta) {
+        return v0 + a * t;
+    }
+    else if (t < ta + tc) {
+        return vp;
+    }
+    else if (t < total) {
+        return vp - a * (t - ta - tc);
+    }
+    else {
+        return v1;
+    }
+}
+
+// MotionProfile function velocity
+// Setpoint velocity at time t (seconds since start)
+float MotionProfile::velocity(float t) {
+    if (window <= 0) {
+        return trapVelocity(t);
+    }
+    return (trapPosition(t) - trapPosition(t - window)) / window;
+}
+
+// MotionProfile function acceleration
+// Setpoint acceleration at time t (seconds since start)
+float MotionProfile::acceleration(float t) {
+    if (window <= 0) {
+        if (t >= 0 && t < ta) {
+            return a;
+        }
+        else if (t >= ta + tc && t < total) {
+            return -a;
+        }
+        return 0;
+    }
+    return (trapVelocity(t) - trapVelocity(t - window)) / window;
+}
+
+// MotionProfile function duration
+// Time until setpoint reaches the end
+float MotionProfile::duration() {
+    return total + window;
+}
+
+// MotionProfile function endVelocity
+// Velocity at the end (may differ from requested if it wasn't reachable)
+float MotionProfile::endVelocity() {
+    return v1;
+}
+
+#endif // PROFILE_H
@@ -0,0 +1,423 @@
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <FEHIO.h>
+#include <FEHUtility.h>
+#include <FEHLCD.h>
+#include <FEHRPS.h>
+#include <FEHAccel.h>
+#include <FEHBattery.h>
+#include <FEHSD.h>
+#include "MK60DZ10.h"
+#include "recordformat.h"
+
+// Set to 1 to log every hardware read to SD (simulator/replay plays the log back)
+#ifndef RECORD_READS
+#define RECORD_READS 0
+#endif
+
+// Log is kept in RAM and written to SD a little at a time while the scheduler is idle,
+// all at once only if it fills up anyway (bytes)
+#define RECORD_BUFFER 16384
+
+// Chunks written per drain, bounds the time spent in one idle gap
+#define RECORD_DRAIN_CHUNKS 2
+
+// Longest record, buffer is written out when less than this is left
+#define RECORD_MAX_LENGTH 32
+
+// Bytes per SD.Printf when writing the buffer out
+#define RECORD_CHUNK 128
+
+// Hardware read recorder
+// Every read the robot makes goes through here, with RECORD_READS the value is also logged
+// Identical records in a row are logged once with a repeat count, so polling loops stay small
+// Values are what the robot used, so playing them back in order reproduces the run
+class Recorder {
+    public:
+        Recorder();
+        void start();
+        void stop();
+        bool drain();
+        void flush();
+        unsigned long timer();
+        double timeNow();
+        unsigned long timeNowMSec();
+        int counts(char letter, int value);
+        float value(char letter, float value);
+        float rpsX();
+        float rpsY();
+        float rpsHeading();
+        float accelX();
+        float accelY();
+        float battery();
+        bool touch(float *x, float *y);
+    private:
+        char buffer[RECORD_READS ? RECORD_BUFFER : 1];
+        int length, written;
+        bool open;
+        char last[RECORD_MAX_LENGTH];
+        int lastLength;
+        unsigned long repeats;
+        uint32_t lastValue[128];
+        void record(const char *text, int textLength);
+        void writeRepeats();
+        void write(int end);
+        static int hex(char *text, uint32_t value);
+        static int decimal(char *text, long value);
+};
+
+// Declare recorder
+Recorder recorder;
+
+// Recorder object constructor
+// Empty log, every last value 0
+Recorder::Recorder() {
+    length = 0;
+    written = 0;
+    open = false;
+    lastLength = 0;
+    repeats = 0;
+    for (int i = 0; i < 128; i++) {
+        lastValue[i] = 0;
+    }
+}
+
+// Recorder function start
+// Opens the SD log
+void Recorder::start() {
+    if (RECORD_READS) {
+        SD.OpenLog();
+        open = true;
+    }
+}
+
+// Recorder function stop
+// Writes out the rest of the log and closes it, reads after this aren't logged
+void Recorder::stop() {
+    if (!open) {
+        return;
+    }
+
+    flush();
+    SD.CloseLog();
+    open = false;
+}
+
+// Recorder function write
+// Writes the buffer from what was written so far up to end to SD
+void Recorder::write(int end) {
+    char chunk[RECORD_CHUNK + 1];
+    while (written < end) {
+        int n = end - written < RECORD_CHUNK ? end - written : RECORD_CHUNK;
+        for (int j = 0; j < n; j++) {
+            chunk[j] = buffer[written + j];
+        }
+        chunk[n] = 0;
+        SD.Printf("%s", chunk);
+        written += n;
+    }
+
+    // Start over at the front once everything is out
+    if (written == length) {
+        written = 0;
+        length = 0;
+    }
+}
+
+// Recorder function drain
+// Writes at most RECORD_DRAIN_CHUNKS chunks, called by the scheduler between tasks
+// Stops after a whole record, so the log on SD never ends partway through one
+// Returns true if anything was written
+bool Recorder::drain() {
+    if (!open || written == length) {
+        return false;
+    }
+
+    int end = written + RECORD_DRAIN_CHUNKS * RECORD_CHUNK;
+    if (end < length) {
+        while (end > written && buffer[end - 1] != '\n') {
+            end--;
+        }
+    }
+    else {
+        end = length;
+    }
+
+    write(end);
+    return true;
+}
+
+// Recorder function flush
+// Writes everything logged so far to SD
+void Recorder::flush() {
+    if (!open) {
+        return;
+    }
+
+    writeRepeats();
+    write(length);
+}
+
+// Recorder function hex
+// Writes value in hex (no leading zeros) to text, returns length
+int Recorder::hex(char *text, uint32_t value) {
+    char digits[8];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[value & 0xF];
+        value >>= 4;
+    } while (value != 0);
+
+    for (int i = 0; i < n; i++) {
+        text[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+// Recorder function decimal
+// Writes value in decimal to text, returns length
+int Recorder::decimal(char *text, long value) {
+    int n = 0;
+    unsigned long magnitude = value;
+    if (value < 0) {
+        text[n++] = '-';
+        magnitude = -value;
+    }
+
+    char digits[12];
+    int d = 0;
+    do {
+        digits[d++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    while (d > 0) {
+        text[n++] = digits[--d];
+    }
+    return n;
+}
+
+// Recorder function writeRepeats
+// Logs the repeat count of the last record, if any
+void Recorder::writeRepeats() {
+    if (repeats > 0) {
+        buffer[length++] = RECORD_REPEAT;
+        length += decimal(buffer + length, repeats);
+        buffer[length++] = '\n';
+        repeats = 0;
+    }
+}
+
+// Recorder function record
+// Logs one record (text without newline), counting it instead if it repeats the last
+void Recorder::record(const char *text, int textLength) {
+    if (!open) {
+        return;
+    }
+
+    bool same = textLength == lastLength;
+    for (int i = 0; same && i < textLength; i++) {
+        same = text[i] == last[i];
+    }
+    if (same) {
+        repeats++;
+        return;
+    }
+
+    if (length > RECORD_BUFFER - 2 * RECORD_MAX_LENGTH) {
+        flush();
+    }
+
+    writeRepeats();
+    for (int i = 0; i < textLength; i++) {
+        buffer[length++] = text[i];
+        last[i] = text[i];
+    }
+    buffer[length++] = '\n';
+    lastLength = textLength;
+}
+
+// Recorder function timer
+// Reads the PIT channel 3 count (see scheduler.h)
+unsigned long Recorder::timer() {
+    unsigned long count = PIT_CVAL3;
+
+    if (RECORD_READS) {
+        char text[RECORD_MAX_LENGTH];
+        text[0] = RECORD_TIMER;
+        int n = 1 + hex(text + 1, (uint32_t)(lastValue[RECORD_TIMER] - count));
+        lastValue[RECORD_TIMER] = count;
+        record(text, n);
+    }
+
+    return count;
+}
+
+// Recorder function timeNow
+// TimeNow, to the microsecond when recording so the log holds it exactly
+double Recorder::timeNow() {
+    if (!RECORD_READS) {
+        return TimeNow();
+    }
+
+    // Rounded, so the value given back reads as the same microsecond when played back
+    uint32_t micros = TimeNow() * 1000000 + 0.5;
+    char text[RECORD_MAX_LENGTH];
+    text[0] = RECORD_TIME;
+    int n = 1 + decimal(text + 1, (int32_t)(micros - lastValue[RECORD_TIME]));
+    lastValue[RECORD_TIME] = micros;
+    record(text, n);
+
+    return micros / 1000000.0;
+}
+
+// Recorder function timeNowMSec
+unsigned long Recorder::timeNowMSec() {
+    unsigned long millis = TimeNowMSec();
+
+    if (RECORD_READS) {
+        char text[RECORD_MAX_LENGTH];
+        text[0] = RECORD_TIME_MSEC;
+        int n = 1 + decimal(text + 1, (int32_t)(millis - lastValue[RECORD_TIME_MSEC]));
+        lastValue[RECORD_TIME_MSEC] = millis;
+        record(text, n);
+    }
+
+    return millis;
+}
+
+// Recorder function counts
+// Logs an encoder read under letter
+int Recorder::counts(char letter, int value) {
+    if (RECORD_READS) {
+        char text[RECORD_MAX_LENGTH];
+        text[0] = letter;
+        int n = 1;
+        long change = value - (int)lastValue[(int)letter];
+        if (change != 0) {
+            n += decimal(text + 1, change);
+        }
+        lastValue[(int)letter] = value;
+        record(text, n);
+    }
+
+    return value;
+}
+
+// Recorder function value
+// Logs a float read under letter
+float Recorder::value(char letter, float value) {
+    if (RECORD_READS) {
+        FloatBits v;
+        v.f = value;
+
+        char text[RECORD_MAX_LENGTH];
+        text[0] = letter;
+        int n = 1;
+        if (v.bits != lastValue[(int)letter]) {
+            n += hex(text + 1, v.bits);
+        }
+        lastValue[(int)letter] = v.bits;
+        record(text, n);
+    }
+
+    return value;
+}
+
+// Recorder function rpsX
+float Recorder::rpsX() {
+    return value(RECORD_RPS_X, RPS.X());
+}
+
+// Recorder function rpsY
+float Recorder::rpsY() {
+    return value(RECORD_RPS_Y, RPS.Y());
+}
+
+// Recorder function rpsHeading
+float Recorder::rpsHeading() {
+    return value(RECORD_RPS_HEADING, RPS.Heading());
+}
+
+// Recorder function accelX
+// Side tilt (g), as a float so recording and playback see the same value
+float Recorder::accelX() {
+    return value(RECORD_ACCEL_X, Accel.X());
+}
+
+// Recorder function accelY
+// Pitch (g)
+float Recorder::accelY() {
+    return value(RECORD_ACCEL_Y, Accel.Y());
+}
+
+// Recorder function battery
+float Recorder::battery() {
+    return value(RECORD_BATTERY, Battery.Voltage());
+}
+
+// Recorder function touch
+// LCD.Touch, the position is only logged while pressed
+bool Recorder::touch(float *x, float *y) {
+    bool pressed = LCD.Touch(x, y);
+
+    if (RECORD_READS) {
+        char text[RECORD_MAX_LENGTH];
+        text[0] = RECORD_TOUCH;
+        text[1] = pressed ? '1' : '0';
+        int n = 2;
+        if (pressed) {
+            FloatBits v;
+            v.f = *x;
+            n += hex(text + n, v.bits);
+            text[n++] = ',';
+            v.f = *y;
+            n += hex(text + n, v.bits);
+        }
+        record(text, n);
+    }
+
+    return pressed;
+}
+
+// Encoder read through the recorder
+// Used as the declared type of the robot's encoders so every Counts call is logged
+class RecordedEncoder : public DigitalEncoder {
+    public:
+        RecordedEncoder(FEHIO::FEHIOPin pin, char letter);
+        int Counts();
+    private:
+        char letter;
+};
+
+// RecordedEncoder object constructor
+RecordedEncoder::RecordedEncoder(FEHIO::FEHIOPin pin, char letter) : DigitalEncoder(pin) {
+    this->letter = letter;
+}
+
+// RecordedEncoder function Counts
+int RecordedEncoder::Counts() {
+    return recorder.counts(letter, DigitalEncoder::Counts());
+}
+
+// Analog input read through the recorder
+class RecordedAnalog : public AnalogInputPin {
+    public:
+        RecordedAnalog(FEHIO::FEHIOPin pin, char letter);
+        float Value();
+    private:
+        char letter;
+};
+
+// RecordedAnalog object constructor
+RecordedAnalog::RecordedAnalog(FEHIO::FEHIOPin pin, char letter) : AnalogInputPin(pin) {
+    this->letter = letter;
+}
+
+// RecordedAnalog function Value
+float RecordedAnalog::Value() {
+    return recorder.value(letter, AnalogInputPin::Value());
+}
+
+#endif // RECORD_H
@@ -0,0 +1,73 @@
+#ifndef RECORDFORMAT_H
+#define RECORDFORMAT_H
+
+#include <stdint.h>
+
+// Format of the read log written by record.h, shared with simulator/replay
+
+// Record letters
+// Counts are the change since the last read of the same letter, floats are their bits in hex
+// and left out when unchanged, the timer is ticks counted down since its last read,
+// time is microseconds (TimeNow) or milliseconds (TimeNowMSec) since its last read
+#define RECORD_TIMER 'T'
+#define RECORD_TIME 'N'
+#define RECORD_TIME_MSEC 'M'
+#define RECORD_LEFT_ENCODER 'L'
+#define RECORD_RIGHT_ENCODER 'R'
+#define RECORD_CDS 'C'
+#define RECORD_RPS_X 'X'
+#define RECORD_RPS_Y 'Y'
+#define RECORD_RPS_HEADING 'H'
+#define RECORD_ACCEL_X 'A'
+#define RECORD_ACCEL_Y 'B'
+#define RECORD_BATTERY 'V'
+#define RECORD_TOUCH 'P'
+
+// Repeats the record before it this many more times
+#define RECORD_REPEAT '+'
+
+// Kinds of record, decides how the value is written
+enum {
+    RECORD_BAD,
+    RECORD_COUNTS,
+    RECORD_FLOAT,
+    RECORD_TICKS,
+    RECORD_MICROS,
+    RECORD_MILLIS,
+    RECORD_PRESS
+};
+
+// Kind of record a letter starts
+inline int recordKind(char letter) {
+    switch (letter) {
+        case RECORD_LEFT_ENCODER:
+        case RECORD_RIGHT_ENCODER:
+            return RECORD_COUNTS;
+        case RECORD_CDS:
+        case RECORD_RPS_X:
+        case RECORD_RPS_Y:
+        case RECORD_RPS_HEADING:
+        case RECORD_ACCEL_X:
+        case RECORD_ACCEL_Y:
+        case RECORD_BATTERY:
+            return RECORD_FLOAT;
+        case RECORD_TIMER:
+            return RECORD_TICKS;
+        case RECORD_TIME:
+            return RECORD_MICROS;
+        case RECORD_TIME_MSEC:
+            return RECORD_MILLIS;
+        case RECORD_TOUCH:
+            return RECORD_PRESS;
+        default:
+            return RECORD_BAD;
+    }
+}
+
+// Bits of a float, to log it exactly
+union FloatBits {
+    float f;
+    uint32_t bits;
+};
+
+#endif // RECORDFORMAT_H
@@ -0,0 +1,189 @@
+#ifndef ROUTE_H
+#define ROUTE_H
+
+#include <FEHLCD.h>
+#include <FEHUtility.h>
+#include <FEHServo.h>
+#include <cmath>
+#include "motion.h"
+#include "motionqueue.h"
+#include "profile.h"
+
+// Estimated time for RPS alignment (s)
+#define ALIGN_TIME 0.5
+
+// Number of segments in a route array
+#define ROUTE_LENGTH(route) (sizeof(route) / sizeof((route)[0]))
+
+// Segment types
+// ROUTE_MOVE: param is move type (DRIVE_F, ...), value is distance in inches
+// ROUTE_SLOW: slow forward with no P, value is distance in inches
+// ROUTE_TIME: param is power, value is time in ms
+// ROUTE_SERVO: param is ARM_UP_POSITION or ARM_DOWN_POSITION, value is time to wait in ms
+// ROUTE_WAIT: value is time in ms
+// ROUTE_ALIGN: RPS heading correction, value is heading
+enum {
+    ROUTE_MOVE,
+    ROUTE_SLOW,
+    ROUTE_TIME,
+    ROUTE_SERVO,
+    ROUTE_WAIT,
+    ROUTE_ALIGN,
+    NUM_ROUTE_TYPES
+};
+
+// Servo positions for ROUTE_SERVO
+enum {
+    ARM_UP_POSITION,
+    ARM_DOWN_POSITION
+};
+
+// One step of a route
+struct Segment {
+    int type;
+    int param;
+    float value;
+};
+
+// Declared in main.cpp
+extern FEHServo armServo;
+extern int armUp, armDown;
+void slowForward(float target);
+void timeDrive(int power, int time);
+void setAngle(float theta);
+
+// Checks route for bad segments
+// Returns index of first bad segment, or -1 if route is fine
+int validateRoute(const Segment *route, int length) {
+    int moves = 0;
+
+    for (int i = 0; i < length; i++) {
+        const Segment &s = route[i];
+
+        if (s.type < 0 || s.type >= NUM_ROUTE_TYPES || s.value != s.value) {
+            return i;
+        }
+
+        // Consecutive moves all go in the motion queue at once
+        moves = s.type == ROUTE_MOVE ? moves + 1 : 0;
+        if (moves > QUEUE_SIZE) {
+            return i;
+        }
+
+        switch (s.type) {
+            case ROUTE_MOVE:
+                if (s.param < DRIVE_F || s.param > DRIVE_B_FAST || s.value <= 0) {
+                    return i;
+                }
+            break;
+            case ROUTE_SLOW:
+                if (s.value <= 0) {
+                    return i;
+                }
+            break;
+            case ROUTE_TIME:
+                if (s.param < -100 || s.param > 100 || s.value < 0) {
+                    return i;
+                }
+            break;
+            case ROUTE_SERVO:
+                if ((s.param != ARM_UP_POSITION && s.param != ARM_DOWN_POSITION) || s.value < 0) {
+                    return i;
+                }
+            break;
+            case ROUTE_WAIT:
+                if (s.value < 0) {
+                    return i;
+                }
+            break;
+            default:
+                if (s.value < 0 || s.value >= 360) {
+                    return i;
+                }
+            break;
+        }
+    }
+    return -1;
+}
+
+// Total distance driven by a route in inches (time drives not included)
+float routeDistance(const Segment *route, int length) {
+    float distance = 0;
+    for (int i = 0; i < length; i++) {
+        if (route[i].type == ROUTE_MOVE || route[i].type == ROUTE_SLOW) {
+            distance += route[i].value;
+        }
+    }
+    return distance;
+}
+
+// Estimated time of a route in seconds
+// Moves use the profile time without blending, so this is an upper bound for them
+float routeTime(const Segment *route, int length) {
+    MotionProfile profile;
+    float time = 0;
+
+    for (int i = 0; i < length; i++) {
+        const Segment &s = route[i];
+
+        switch (s.type) {
+            case ROUTE_MOVE:
+                profile.generate(s.value * TICKS_PER_INCH, percentToVelocity(moveTypes[s.param].max),
+                                 MAX_ACCEL * TICKS_PER_INCH, MAX_JERK * TICKS_PER_INCH);
+                time += profile.duration();
+            break;
+            case ROUTE_SLOW:
+                time += s.value / (20 / KV);
+            break;
+            case ROUTE_SERVO:
+            case ROUTE_TIME:
+            case ROUTE_WAIT:
+                time += s.value / 1000.0;
+            break;
+            case ROUTE_ALIGN:
+                time += ALIGN_TIME;
+            break;
+        }
+    }
+    return time;
+}
+
+// Route interpreter
+// Consecutive moves are all handed to the motion queue before waiting, so the
+// next move's parameters are ready when the current one ends and moves blend
+// Any other segment waits for the queue to finish first
+void runRoute(const Segment *route, int length) {
+    for (int i = 0; i < length; i++) {
+        const Segment &s = route[i];
+
+        if (s.type == ROUTE_MOVE) {
+            motionQueue.add(s.param, s.value);
+            continue;
+        }
+
+        motionQueue.wait();
+
+        switch (s.type) {
+            case ROUTE_SLOW:
+                slowForward(s.value);
+            break;
+            case ROUTE_TIME:
+                timeDrive(s.param, s.value);
+            break;
+            case ROUTE_SERVO:
+                armServo.SetDegree(s.param == ARM_DOWN_POSITION ? armDown : armUp);
+                scheduler.wait(s.value / 1000);
+            break;
+            case ROUTE_WAIT:
+                scheduler.wait(s.value / 1000);
+            break;
+            case ROUTE_ALIGN:
+                setAngle(s.value);
+            break;
+        }
+    }
+
+    motionQueue.wait();
+}
+
+#endif // ROUTE_H
@@ -0,0 +1,139 @@
+#ifndef RPS_H
+#define RPS_H
+
+#include <FEHRPS.h>
+#include "scheduler.h"
+
+// RPS polling rate (Hz), faster than RPS sends packets
+#define RPS_RATE 50
+
+// Snapshot is stale if no new packet came for this long (s)
+#define RPS_STALE_TIME 0.5
+
+// Tries to get the three values from one packet before giving up
+#define RPS_READ_TRIES 3
+
+// RPS status values
+enum {
+    RPS_OK = 0,
+    RPS_NO_SIGNAL = -1,
+    RPS_DEAD_ZONE = -2
+};
+
+// One RPS packet
+// x, y in inches and heading in degrees as given by RPS
+// time is timeMicros when the packet was first seen, sequence counts packets
+// status is RPS_OK, RPS_NO_SIGNAL or RPS_DEAD_ZONE
+struct RPSSnapshot {
+    float x, y, heading;
+    unsigned long time;
+    unsigned long sequence;
+    int status;
+    bool valid() const;
+};
+
+// RPSSnapshot function valid
+bool RPSSnapshot::valid() const {
+    return status == RPS_OK;
+}
+
+// RPS cache
+// Reads RPS once per poll and hands the same snapshot to everyone
+// The firmware has no packet counter, so a packet is new when any value changes
+// (a robot sitting perfectly still can look stale for that reason)
+// Registered as a scheduler task with start, call update directly before that
+class RPSCache {
+    public:
+        RPSCache();
+        void start();
+        void update();
+        const RPSSnapshot &get();
+        float age();
+        bool stale();
+    private:
+        RPSSnapshot snapshot;
+        static void task();
+};
+
+// Declare cache
+RPSCache rps;
+
+// RPSCache object constructor
+// No packet yet
+RPSCache::RPSCache() {
+    snapshot.x = RPS_NO_SIGNAL;
+    snapshot.y = RPS_NO_SIGNAL;
+    snapshot.heading = RPS_NO_SIGNAL;
+    snapshot.time = 0;
+    snapshot.sequence = 0;
+    snapshot.status = RPS_NO_SIGNAL;
+}
+
+// RPSCache function start
+// Registers polling task
+void RPSCache::start() {
+    scheduler.addTask(task, RPS_RATE);
+}
+
+// RPSCache function update
+// Reads RPS, reading again if a packet came in between the three values
+// All three are compared, status comes from them so it's covered too
+void RPSCache::update() {
+    float x = 0, y = 0, heading = 0;
+
+    for (int i = 0; i < RPS_READ_TRIES; i++) {
+        x = recorder.rpsX();
+        y = recorder.rpsY();
+        heading = recorder.rpsHeading();
+        if (recorder.rpsX() == x && recorder.rpsY() == y && recorder.rpsHeading() == heading) {
+            break;
+        }
+    }
+
+    if (x == snapshot.x && y == snapshot.y && heading == snapshot.heading) {
+        return;
+    }
+
+    snapshot.x = x;
+    snapshot.y = y;
+    snapshot.heading = heading;
+    snapshot.time = timeMicros();
+    snapshot.sequence++;
+
+    // Invalid packets give the same negative value for everything
+    if (x == RPS_DEAD_ZONE || y == RPS_DEAD_ZONE) {
+        snapshot.status = RPS_DEAD_ZONE;
+    }
+    else if (x < 0 || y < 0 || heading < 0) {
+        snapshot.status = RPS_NO_SIGNAL;
+    }
+    else {
+        snapshot.status = RPS_OK;
+    }
+}
+
+// RPSCache function get
+// Latest snapshot
+const RPSSnapshot &RPSCache::get() {
+    return snapshot;
+}
+
+// RPSCache function age
+// Seconds since latest packet
+float RPSCache::age() {
+    return (timeMicros() - snapshot.time) / 1000000.0;
+}
+
+// RPSCache function stale
+// True if there is no packet yet or it's too old to trust
+bool RPSCache::stale() {
+    return snapshot.sequence == 0 || age() > RPS_STALE_TIME;
+}
+
+// RPSCache function task
+// Polling task registered with the scheduler
+void RPSCache::task() {
+    rps.update();
+}
+
+#endif // RPS_H
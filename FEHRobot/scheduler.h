@@ -0,0 +1,216 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "MK60DZ10.h"
+#include "record.h"
+
+// Bus clock driving the PIT (Hz)
+#define BUS_CLOCK 50000000
+
+// Maximum number of registered tasks
+#define MAX_TASKS 8
+
+// Control task rate (Hz), same as LOOP_TIME
+#define CONTROL_RATE 50
+
+// Longest sleep between ticks while recording (us)
+#define MAX_IDLE 10000
+
+// Time before the next deadline needed to write some of the log while idle (us)
+#define RECORD_DRAIN_TIME 3000
+
+// Free-running microsecond timer
+// PIT channel 3 counts down from 0xFFFFFFFF at bus clock and wraps every ~85 s,
+// so the elapsed ticks are accumulated into 64 bits on every read
+// Must be read at least once per wrap (the scheduler does this while waiting)
+bool timerStarted = false;
+unsigned long lastTimerCount = 0;
+unsigned long long timerTicks = 0;
+
+// Starts PIT channel 3
+void startTimer() {
+    SIM_SCGC6 |= SIM_SCGC6_PIT_MASK;
+    PIT_MCR &= ~PIT_MCR_MDIS_MASK;
+
+    PIT_TCTRL3 = 0;
+    PIT_LDVAL3 = 0xFFFFFFFF;
+    PIT_TCTRL3 = PIT_TCTRL_TEN_MASK;
+
+    lastTimerCount = recorder.timer();
+    timerStarted = true;
+}
+
+// Returns microseconds since timer started
+unsigned long timeMicros() {
+    if (!timerStarted) {
+        startTimer();
+    }
+
+    // Counter counts down, 32 bit unsigned subtraction handles the wrap
+    // (also where unsigned long is 64 bits, like the host simulator)
+    unsigned long count = recorder.timer();
+    timerTicks += (uint32_t)(lastTimerCount - count);
+    lastTimerCount = count;
+
+    return timerTicks / (BUS_CLOCK / 1000000);
+}
+
+// Fixed rate task scheduler
+// Tasks are called from the main loop (not the interrupt) so they can use LCD and RPS
+// Each task has a deadline that advances by exactly one period, so the rate
+// doesn't drift with how long the task takes
+// Missed deadlines are counted as overruns and skipped instead of run back to back
+// While recording, waits between deadlines sleep instead of polling the timer
+class Scheduler {
+    public:
+        Scheduler();
+        int addTask(void (*function)(), float rate);
+        void removeTask(int id);
+        void tick();
+        void run(bool (*done)());
+        void wait(float seconds);
+        float period(int id);
+        int overruns(int id);
+        int totalOverruns();
+    private:
+        void idle(unsigned long until);
+        struct Task {
+            void (*function)();
+            unsigned long period;
+            unsigned long next;
+            int overruns;
+        };
+        Task tasks[MAX_TASKS];
+        int missed;
+};
+
+// Scheduler object constructor
+// All task slots empty
+Scheduler::Scheduler() {
+    for (int i = 0; i < MAX_TASKS; i++) {
+        tasks[i].function = 0;
+    }
+    missed = 0;
+}
+
+// Scheduler function addTask
+// Registers function to be called at rate (Hz)
+// Returns task id, or -1 if all slots are used
+int Scheduler::addTask(void (*function)(), float rate) {
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (tasks[i].function == 0) {
+            tasks[i].function = function;
+            tasks[i].period = 1000000 / rate;
+            tasks[i].next = timeMicros();
+            tasks[i].overruns = 0;
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Scheduler function removeTask
+// Frees task slot, overruns are kept in the total
+void Scheduler::removeTask(int id) {
+    if (id >= 0 && id < MAX_TASKS && tasks[id].function != 0) {
+        missed += tasks[id].overruns;
+        tasks[id].function = 0;
+    }
+}
+
+// Scheduler function tick
+// Calls every task whose deadline has passed and advances its deadline
+void Scheduler::tick() {
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (tasks[i].function != 0 && (long)(timeMicros() - tasks[i].next) >= 0) {
+            tasks[i].function();
+            tasks[i].next += tasks[i].period;
+
+            // Skip (and count) deadlines that already passed
+            while ((long)(timeMicros() - tasks[i].next) >= 0) {
+                tasks[i].next += tasks[i].period;
+                tasks[i].overruns++;
+            }
+        }
+    }
+}
+
+// Scheduler function idle
+// When recording, writes some of the log out and sleeps until the next deadline (or until)
+// so the log isn't filled with timer reads, done only changes in tasks so nothing is missed
+// Sleep is in whole ms, so tasks may start up to 1 ms late
+void Scheduler::idle(unsigned long until) {
+    if (!RECORD_READS) {
+        return;
+    }
+
+    unsigned long now = timeMicros();
+    if ((long)(until - now) > MAX_IDLE) {
+        until = now + MAX_IDLE;
+    }
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (tasks[i].function != 0 && (long)(tasks[i].next - until) < 0) {
+            until = tasks[i].next;
+        }
+    }
+
+    // Write some of the log to SD if there is time before the next deadline
+    if ((long)(until - now) > RECORD_DRAIN_TIME && recorder.drain()) {
+        now = timeMicros();
+    }
+
+    if ((long)(until - now) > 0) {
+        Sleep((int)((until - now + 999) / 1000));
+    }
+}
+
+// Scheduler function run
+// Runs tasks until done returns true (checked after every tick)
+void Scheduler::run(bool (*done)()) {
+    tick();
+    while (!done()) {
+        idle(timeMicros() + MAX_IDLE);
+        tick();
+    }
+}
+
+// Scheduler function wait
+// Runs tasks for set time, replaces Sleep while tasks are registered
+void Scheduler::wait(float seconds) {
+    unsigned long start = timeMicros();
+    unsigned long length = seconds * 1000000;
+
+    while (timeMicros() - start < length) {
+        tick();
+        idle(start + length);
+    }
+}
+
+// Scheduler function period
+// Returns exact time between calls of a task in seconds
+float Scheduler::period(int id) {
+    return tasks[id].period / 1000000.0;
+}
+
+// Scheduler function overruns
+// Returns number of missed deadlines of a task
+int Scheduler::overruns(int id) {
+    return tasks[id].overruns;
+}
+
+// Scheduler function totalOverruns
+// Returns missed deadlines of all tasks, including removed ones
+int Scheduler::totalOverruns() {
+    int total = missed;
+    for (int i = 0; i < MAX_TASKS; i++) {
+        if (tasks[i].function != 0) {
+            total += tasks[i].overruns;
+        }
+    }
+    return total;
+}
+
+// Declare scheduler
+Scheduler scheduler;
+
+#endif // SCHEDULER_H
@@ -10,38 +10,46 @@
 
 #define LOOP_TIME 0.020   // 20 ms, 50 Hz
 
+#define VELOCITY_WINDOW 5   // Updates per velocity estimate (100 ms)
+#define VELOCITY_FILTER 0.5 // Velocity low pass filter (0 to 1, higher is smoother)
+
 using namespace std;
 
 // PID class
 // lastTime stores time of previous calculation
 // kP, kI, kD, kF are constants for PID
 // lastValue stores the last value of the signal input
-// sigma stores the total error
+// sigma stores the total error, lastStep the last amount added to it
+// maxOutput is the output limit
 class PID {
     public:
-        PID(float p, float i, float d, float f);
+        PID(float p, float i, float d, float f, float max = MAX_POWER);
         void setConstants(float p, float i, float d, float f);
         void initialize();
         float calculate(float target, float sensorValue, float range = 10000);
+        void hold();
     private:
         float lastTime;
         float kP, kI, kD, kF;
+        float maxOutput;
         float lastValue;
-        float sigma;
+        float sigma, lastStep;
 };
 
 // PID object constructor
 // lastTime set to current time
-// kP, kI, kD, kF set to inputted values
+// kP, kI, kD, kF, maxOutput set to inputted values
 // lastValue, sigma set to 0
-PID::PID(float p, float i, float d, float f) {
+PID::PID(float p, float i, float d, float f, float max) {
     lastTime = TimeNow();
     kP = p;
     kI = i;
     kD = d;
     kF = f;
+    maxOutput = max;
     lastValue = 0;
     sigma = 0;
+    lastStep = 0;
 }
 
 // PID function setConstants
@@ -57,6 +65,7 @@ void PID::setConstants(float p, float i, float d, float f) {
     kF = f;
     lastValue = 0;
     sigma = 0;
+    lastStep = 0;
 }
 
 // PID function initialize
@@ -65,6 +74,7 @@ void PID::initialize() {
     lastTime = TimeNow() - LOOP_TIME;
     lastValue = 0;
     sigma = 0;
+    lastStep = 0;
 }
 
 // PID function calculate
@@ -88,7 +98,8 @@ float PID::calculate(float target, float sensorValue, float range) {
     error = target - sensorValue;
 
     // Calculate sigma (I)
-    sigma += error * deltaTime;
+    lastStep = error * deltaTime;
+    sigma += lastStep;
 
     // Reset sigma if outside of integral range
     if(fabs(error) > range) {
@@ -116,11 +127,83 @@ float PID::calculate(float target, float sensorValue, float range) {
     output = kP * error + kI * sigma + kD * derivative + kF * target;
 
     // Limit output with threshold
-    if (fabs(output) > MAX_POWER) {
-        output = MAX_POWER * output / fabs(output);
+    // Stop integrating while clamped and the error pushes further into the clamp (anti-windup)
+    if (fabs(output) > maxOutput) {
+        output = maxOutput * output / fabs(output);
+        if (error * output > 0) {
+            hold();
+        }
     }
 
     return output;
 }
 
+// PID function hold
+// Takes back the last integral step
+// Call when the output was limited after calculate (slew rate) so sigma doesn't wind up
+void PID::hold() {
+    sigma -= lastStep;
+    lastStep = 0;
+}
+
+// Velocity estimator
+// Change in position over the last VELOCITY_WINDOW updates divided by the time it took,
+// then low pass filtered. A single loop is only a few counts, too coarse to control on
+// history stores positions and times of the last updates, index is the oldest
+// filtered stores the estimate
+class VelocityEstimator {
+    public:
+        VelocityEstimator();
+        void initialize(float position);
+        float update(float position);
+        float velocity();
+    private:
+        float positionHistory[VELOCITY_WINDOW], timeHistory[VELOCITY_WINDOW];
+        int index;
+        float filtered;
+};
+
+// VelocityEstimator object constructor
+// Starts at rest at 0
+VelocityEstimator::VelocityEstimator() {
+    initialize(0);
+}
+
+// VelocityEstimator function initialize
+// Called at the beginning of control loop, robot must be at rest
+void VelocityEstimator::initialize(float position) {
+    float currentTime = TimeNow();
+    for (int i = 0; i < VELOCITY_WINDOW; i++) {
+        positionHistory[i] = position;
+        timeHistory[i] = currentTime - (VELOCITY_WINDOW - i) * LOOP_TIME;
+    }
+    index = 0;
+    filtered = 0;
+}
+
+// VelocityEstimator function update
+// Adds a position and returns the new estimate (position units per second)
+float VelocityEstimator::update(float position) {
+    float currentTime = TimeNow();
+    float deltaTime = currentTime - timeHistory[index];
+
+    if (deltaTime > 0) {
+        float raw = (position - positionHistory[index]) / deltaTime;
+        filtered = VELOCITY_FILTER * filtered + (1 - VELOCITY_FILTER) * raw;
+    }
+
+    // Replace oldest
+    positionHistory[index] = position;
+    timeHistory[index] = currentTime;
+    index = (index + 1) % VELOCITY_WINDOW;
+
+    return filtered;
+}
+
+// VelocityEstimator function velocity
+// Latest estimate
+float VelocityEstimator::velocity() {
+    return filtered;
+}
+
 #endif
@@ -9,7 +9,17 @@
 #define LOOP_TIME 0.020   // 20 ms, 50 Hz
 
 #define MAX_VELOCITY 28 // Max (reasonable) velocity in in/s
-#define VELOCITY_RANGE 12 // Range of velocity PID in in
+#define VELOCITY_RANGE 12 // Distance from target where velocity starts dropping in in
+#define MAX_ACCEL 40 // Max acceleration in in/s^2
+
+#define KP_VELOCITY 1.0 // Wheel velocity loop in percent per in/s
+#define KI_VELOCITY 2.0
+#define KF_VELOCITY 2.5 // Feedforward, percent per in/s of setpoint
+#define MAX_OUTPUT 90 // Wheel output limit in percent, above KF_VELOCITY * MAX_VELOCITY (70) to leave room for PI
+#define KP_DRIFT 2.0 // Drift correction in in/s per in
+
+#define SETTLE_RANGE 0.25 // Close enough to target in in
+#define SETTLE_TIME 0.25 // Time close to target before ending in s
 
 #define TICKS_PER_INCH 39 // Conversion from encoder ticks to in
 
@@ -24,105 +34,116 @@ FEHMotor rightBase(FEHMotor::Motor1, 9);
 DigitalEncoder leftEnc(FEHIO::P0_0);
 DigitalEncoder rightEnc(FEHIO::P1_0);
 
-// PID control loop
-// target is desired encoder count, vTarget is desired velocity, vRange is active range of velocity PID
-// Velocity PID until some distance to target
-// Position PID when some distance away
-// Drift PID and slew rate are constantly active
-// Ends function 250 ms after gets close
+// Cascaded control loop
+// target is distance (in), vTarget is cruise velocity (in/s), vRange is distance (in) from target where it starts slowing
+// Outer loop turns position error into a wheel velocity setpoint limited to vTarget, MAX_ACCEL
+// and the velocity it can still stop from
+// Inner loop is velocity PI with feedforward on each wheel's filtered velocity
+// Setpoint goes to 0 at the target, so cruise hands off to position hold without switching loops
+// Encoders don't know direction, so each wheel's counts take the sign of its last output
+// Drift PID trims the wheel setpoints and slew rate is constantly active
+// Ends SETTLE_TIME after getting within SETTLE_RANGE
 // MAX_STEP is slew rate limit (10%)
 // LOOP_TIME is time per update (20 ms)
 void autoDrive(float target, float vTarget = MAX_VELOCITY, float vRange = VELOCITY_RANGE) {
-    PID basePID(0.4, 0.001, 0, 0), velocityPID(0.01, 0, 0, 0), driftPID(1, 0, 0, 0);
+    PID leftPID(KP_VELOCITY, KI_VELOCITY, 0, KF_VELOCITY, MAX_OUTPUT), rightPID(KP_VELOCITY, KI_VELOCITY, 0, KF_VELOCITY, MAX_OUTPUT);
+    PID driftPID(KP_DRIFT, 0, 0, 0);
+    VelocityEstimator leftVelocity, rightVelocity;
 
     bool done = false;
-    float closeTime;
-    float driveOut, driftOut;
+    float kPosition = vTarget / vRange;
+    float closeTime = TimeNow();
+    float error, distance, vSet = 0, lastVSet = 0, driftOut;
+    float posL = 0, posR = 0, avgPos, currentTime;
     float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc, currentTime;
-    float velocity, lastAvgEnc = 0, lastTime = TimeNow() - LOOP_TIME;
+    int countsL, countsR, lastCountsL = 0, lastCountsR = 0;
 
-    target *= TICKS_PER_INCH;
-    vTarget *= TICKS_PER_INCH;
-    vRange *= TICKS_PER_INCH * target / fabs(target);
-
-    basePID.initialize();
-    velocityPID.initialize();
+    leftPID.initialize();
+    rightPID.initialize();
     driftPID.initialize();
 
-    // Consider allowing for accumulating error
     leftEnc.ResetCounts();
     rightEnc.ResetCounts();
+    leftVelocity.initialize(0);
+    rightVelocity.initialize(0);
 
     while(!done) {
         // Update current time
         currentTime = TimeNow();
 
-        // Update average distance
-        avgEnc = (leftEnc.Counts() + rightEnc.Counts()) / 2;
-
-        // Calculate velocity
-        velocity = (avgEnc - lastAvgEnc) / (currentTime - lastTime);
-        lastAvgEnc = avgEnc;
-        lastTime = currentTime;
-
-        // Drift PID
-        driftOut = driftPID.calculate(0, leftEnc.Counts() - rightEnc.Counts());
-
-        // Velocity PID
-        if(fabs(target) - fabs(avgEnc) > vRange) {
-            driveOut = velocityPID.calculate(vTarget, velocity);
-
-            // Calculate motor outputs
-            // Limit driveOut contribution so driftOut can have affect it?
-            outL += driveOut;
-            outR += driveOut;
+        // Signed wheel positions (in)
+        countsL = leftEnc.Counts();
+        countsR = rightEnc.Counts();
+        posL += (lastOutL < 0 ? -1 : 1) * (countsL - lastCountsL) / (float)TICKS_PER_INCH;
+        posR += (lastOutR < 0 ? -1 : 1) * (countsR - lastCountsR) / (float)TICKS_PER_INCH;
+        lastCountsL = countsL;
+        lastCountsR = countsR;
+        avgPos = (posL + posR) / 2;
+
+        // Outer loop: velocity setpoint from remaining distance
+        error = target - avgPos;
+        distance = fabs(error);
+        vSet = vTarget;
+        if(kPosition * distance < vSet) {
+            vSet = kPosition * distance;
+        }
+        if(sqrt(2 * MAX_ACCEL * distance) < vSet) {
+            vSet = sqrt(2 * MAX_ACCEL * distance);
+        }
+        vSet *= error < 0 ? -1 : 1;
 
-            LCD.WriteLine(driveOut);
+        // Acceleration limit (slowing down is already limited by the stopping velocity)
+        if(vSet - lastVSet > MAX_ACCEL * LOOP_TIME && vSet > 0) {
+            vSet = lastVSet + MAX_ACCEL * LOOP_TIME;
         }
+        else if(vSet - lastVSet < -MAX_ACCEL * LOOP_TIME && vSet < 0) {
+            vSet = lastVSet - MAX_ACCEL * LOOP_TIME;
+        }
+        lastVSet = vSet;
 
-        // Position PID
-        else {
-            driveOut = basePID.calculate(target, avgEnc);
+        // Drift PID
+        driftOut = driftPID.calculate(0, posL - posR);
 
-            // Calculate motor outputs
-            // Limit driveOut contribution so driftOut can have affect it?
-            outL = driveOut;
-            outR = driveOut;
-        }
+        // Inner loop: wheel velocity PI with feedforward
+        outL = leftPID.calculate(vSet + driftOut, leftVelocity.update(posL));
+        outR = rightPID.calculate(vSet - driftOut, rightVelocity.update(posR));
 
-        // Slew rate limit
-        if(outL + driftOut - lastOutL > MAX_STEP) {
-            outL = lastOutL + 10;
+        // Slew rate limit, velocity PI stops integrating while limited
+        if(outL - lastOutL > MAX_STEP) {
+            outL = lastOutL + MAX_STEP;
+            leftPID.hold();
         }
-        else if(outL + driftOut - lastOutL < -MAX_STEP) {
-            outL = lastOutL - 10;
+        else if(outL - lastOutL < -MAX_STEP) {
+            outL = lastOutL - MAX_STEP;
+            leftPID.hold();
         }
 
-        if(outR - driftOut - lastOutR > MAX_STEP) {
-            outR = lastOutR + 10;
+        if(outR - lastOutR > MAX_STEP) {
+            outR = lastOutR + MAX_STEP;
+            rightPID.hold();
         }
-        else if(outR - driftOut - lastOutR < -MAX_STEP) {
-            outR = lastOutR - 10;
+        else if(outR - lastOutR < -MAX_STEP) {
+            outR = lastOutR - MAX_STEP;
+            rightPID.hold();
         }
 
         // Set motors to output
-        leftBase.SetPercent(outL + driftOut);
-        rightBase.SetPercent(outR - driftOut);
+        leftBase.SetPercent(outL);
+        rightBase.SetPercent(outR);
 
-        // Store output for slew rate
-        lastOutL = outL + driftOut;
-        lastOutR = outR - driftOut;
+        // Store output for slew rate and direction
+        lastOutL = outL;
+        lastOutR = outR;
 
         // Sleep for set time
         Sleep(LOOP_TIME);
 
-        // Loop ends .25 seconds after average gets within 100 ticks
-        if(fabs(target - avgEnc) > 100) {
+        // Loop ends SETTLE_TIME after average gets within SETTLE_RANGE
+        if(distance > SETTLE_RANGE) {
             closeTime = currentTime;
         }
 
-        if(currentTime - closeTime > 250) {
+        if(currentTime - closeTime > SETTLE_TIME) {
             done = true;
         }
     }
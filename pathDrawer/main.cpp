@@ -2,18 +2,22 @@
 #include <FEHIO.h>
 #include <FEHUtility.h>
 #include <FEHMotor.h>
-#include <stdlib.h>
 #include <cmath>
+#include "path.h"
+#include "pursuit.h"
 
 #define TICKS_PER_INCH 28
 #define INCH_PER_PIXEL 0.2
 #define RADIUS 3
-#define MAXIMUM_POINTS 100
-#define SKIP_SOME 4
 #define PI 3.1415926536
 
 using namespace std;
 
+// Path storage, static so redrawing never allocates
+float rawX[MAX_RAW_POINTS], rawY[MAX_RAW_POINTS];
+float keyX[MAX_KEY_POINTS], keyY[MAX_KEY_POINTS];
+float pathX[MAX_PATH_POINTS], pathY[MAX_PATH_POINTS];
+
 void displayMenu() {
     LCD.DrawRectangle(1, 0, 240, 180);
 }
@@ -36,22 +40,16 @@ int main(void) {
     DigitalEncoder rightEnc(FEHIO::P0_0);
     DigitalEncoder leftEnc(FEHIO::P1_0);
 
+    PurePursuit follower(leftBase, rightBase, leftEnc, rightEnc, TICKS_PER_INCH, 2 * RADIUS);
+
     bool done = false, doneDrawing = false;
 
     int index = 0;
 
-    int counter = 0;
-
     while (!done) {
 
-        int* xPosition;
-        int* yPosition;
-        int* lCounts = (int*) calloc(MAXIMUM_POINTS - 1, sizeof(int));
-        int* rCounts = (int*) calloc(MAXIMUM_POINTS - 1, sizeof(int));
-
         while (!doneDrawing) {
-            xPosition = (int*) calloc(MAXIMUM_POINTS, sizeof(int));
-            yPosition = (int*) calloc(MAXIMUM_POINTS, sizeof(int));
+            index = 0;
 
             LCD.Clear(FEHLCD::Black);
             displayMenu();
@@ -65,17 +63,14 @@ int main(void) {
                     y = 180;
                 }
 
-                if (index < MAXIMUM_POINTS) {
+                // Keep every sample that moved, simplification drops the extra ones
+                if (index < MAX_RAW_POINTS) {
                     LCD.DrawPixel(x, y);
 
-                    counter++;
-                    if (counter >= SKIP_SOME) {
-                        if (x != *(xPosition + index) || y != *(yPosition + index)) {
-                            counter = 0;
-                            *(xPosition + index) = x;
-                            *(yPosition + index) = y;
-                            index++;
-                        }
+                    if (index == 0 || x != rawX[index - 1] || y != rawY[index - 1]) {
+                        rawX[index] = x;
+                        rawY[index] = y;
+                        index++;
                     }
                 }
 
@@ -91,90 +86,18 @@ int main(void) {
         }
         LCD.Clear(FEHLCD::Black);
 
-        double lastTheta = 0;
-
-        for (int i = 0; i < index - 1; i++) {
-            int deltaX = *(xPosition + i + 1) - *(xPosition + i);
-            int deltaY = *(yPosition + i + 1) - *(yPosition + i);
-            double r = sqrt(deltaX * deltaX + deltaY * deltaY);
-
-            double theta = 0;
-            if (y >= 0) {
-                if (y == 0) {
-                    if (x == 0) {
-                        theta = 0;
-                    }
-                    else if (x > 0) {
-                        theta = PI / 2;
-                    }
-                    else {
-                        theta = - PI / 2;
-                    }
-                }
-                else {
-                    theta = atan(((double) deltaX) / deltaY);
-                }
-            }
-            else {
-                theta = atan(((double) deltaX) / deltaY) + PI;
-            }
-
-            double dist = r * INCH_PER_PIXEL * TICKS_PER_INCH;
-            double diff = RADIUS * TICKS_PER_INCH * (theta - lastTheta);
-
-            lastTheta = theta;
-
-            *(lCounts + i) = dist - diff;
-            *(rCounts + i) = dist + diff;
-        }
-
-        for (int i = 0; i < index - 1; i++) {
-            leftEnc.ResetCounts();
-            rightEnc.ResetCounts();
-
-            bool leftDone = false, rightDone = false;
-            int leftTarget, rightTarget;
-
-            if (*(lCounts + i) < 0) {
-                leftTarget = -*(lCounts + i);
-                leftBase.SetPercent(15);
-            }
-            else {
-                leftTarget = *(lCounts + i);
-                leftBase.SetPercent(-15);
-            }
-
-            if (*(rCounts + i) < 0) {
-                rightTarget = -*(rCounts + i);
-                rightBase.SetPercent(-15);
-            }
-            else {
-                rightTarget = *(rCounts + i);
-                rightBase.SetPercent(15);
-            }
-
-            while (!leftDone || !rightDone) {
-                if (leftEnc.Counts() > leftTarget) {
-                    leftBase.SetPercent(0);
-                    leftDone = true;
-                }
-                if (rightEnc.Counts() > rightTarget) {
-                    rightBase.SetPercent(0);
-                    rightDone = true;
-                }
-            }
-
-            Sleep(10);
-
+        // Path in inches from first point, screen y is down
+        for (int i = index - 1; i >= 0; i--) {
+            rawX[i] = (rawX[i] - rawX[0]) * INCH_PER_PIXEL;
+            rawY[i] = (rawY[0] - rawY[i]) * INCH_PER_PIXEL;
         }
 
-        free(xPosition);
-        free(yPosition);
-        free(lCounts);
-        free(rCounts);
+        // Few key points, then a smooth curve through them
+        int keys = simplify(rawX, rawY, index, SIMPLIFY_EPSILON, keyX, keyY, MAX_KEY_POINTS);
+        int length = smooth(keyX, keyY, keys, pathX, pathY, MAX_PATH_POINTS);
 
-        index = 0;
-        counter = 0;
+        // Follow whole path, robot starts facing up the screen
+        follower.follow(pathX, pathY, length, PI / 2);
 
         doneDrawing = false;
     }
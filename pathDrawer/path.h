@@ -0,0 +1,165 @@
+#ifndef PATH_H
+#define PATH_H
+
+#include <cmath>
+
+using namespace std;
+
+// Storage sizes (all buffers are static, nothing is allocated)
+#define MAX_RAW_POINTS 400
+#define MAX_KEY_POINTS 32
+#define SPLINE_SAMPLES 8
+#define MAX_PATH_POINTS ((MAX_KEY_POINTS + 1) * SPLINE_SAMPLES + 1)
+
+// Simplification tolerance (same unit as the points)
+#define SIMPLIFY_EPSILON 0.5
+
+// Work space for simplify
+bool keepPoint[MAX_RAW_POINTS];
+int stackFirst[MAX_RAW_POINTS], stackLast[MAX_RAW_POINTS];
+
+// Distance from point to line through a and b
+float lineDistance(float x, float y, float ax, float ay, float bx, float by) {
+    float dx = bx - ax, dy = by - ay;
+    float length = sqrt(dx * dx + dy * dy);
+    if (length == 0) {
+        return sqrt((x - ax) * (x - ax) + (y - ay) * (y - ay));
+    }
+    return fabs(dy * (x - ax) - dx * (y - ay)) / length;
+}
+
+// Ramer-Douglas-Peucker simplification
+// Keeps the points needed to stay within epsilon of the original line
+// Uses an explicit stack instead of recursion
+// Returns number of points written to outX, outY (at most maxOut, tolerance is
+// doubled until it fits)
+int simplify(const float *x, const float *y, int length, float epsilon, float *outX, float *outY, int maxOut) {
+    if (length > MAX_RAW_POINTS) {
+        length = MAX_RAW_POINTS;
+    }
+    if (length <= 2) {
+        for (int i = 0; i < length; i++) {
+            outX[i] = x[i];
+            outY[i] = y[i];
+        }
+        return length;
+    }
+
+    int count = maxOut + 1;
+    while (count > maxOut) {
+        for (int i = 0; i < length; i++) {
+            keepPoint[i] = false;
+        }
+        keepPoint[0] = true;
+        keepPoint[length - 1] = true;
+
+        int top = 0;
+        stackFirst[top] = 0;
+        stackLast[top] = length - 1;
+        top++;
+
+        while (top > 0) {
+            top--;
+            int first = stackFirst[top], last = stackLast[top];
+
+            // Farthest point from the line between first and last
+            float farthest = 0;
+            int index = first;
+            for (int i = first + 1; i < last; i++) {
+                float distance = lineDistance(x[i], y[i], x[first], y[first], x[last], y[last]);
+                if (distance > farthest) {
+                    farthest = distance;
+                    index = i;
+                }
+            }
+
+            // Keep it and split there if it's too far
+            if (farthest > epsilon) {
+                keepPoint[index] = true;
+                stackFirst[top] = first;
+                stackLast[top] = index;
+                top++;
+                stackFirst[top] = index;
+                stackLast[top] = last;
+                top++;
+            }
+        }
+
+        count = 0;
+        for (int i = 0; i < length; i++) {
+            if (keepPoint[i]) {
+                count++;
+            }
+        }
+
+        epsilon *= 2;
+    }
+
+    int n = 0;
+    for (int i = 0; i < length; i++) {
+        if (keepPoint[i]) {
+            outX[n] = x[i];
+            outY[n] = y[i];
+            n++;
+        }
+    }
+    return n;
+}
+
+// Uniform cubic B-spline through the end points
+// Inner points pull the curve without it passing through them, which smooths corners
+// End points are tripled so the curve starts and ends exactly on them
+// Returns number of samples written to outX, outY (at most maxOut)
+int smooth(const float *x, const float *y, int length, float *outX, float *outY, int maxOut) {
+    if (length < 2) {
+        for (int i = 0; i < length && i < maxOut; i++) {
+            outX[i] = x[i];
+            outY[i] = y[i];
+        }
+        return length < maxOut ? length : maxOut;
+    }
+
+    // Control points with tripled ends: index -2..length+1 maps to 0..length-1
+    int controls = length + 4;
+    int n = 0;
+
+    for (int span = 0; span < controls - 3; span++) {
+        float px[4], py[4];
+        for (int k = 0; k < 4; k++) {
+            int i = span + k - 2;
+            i = i < 0 ? 0 : (i > length - 1 ? length - 1 : i);
+            px[k] = x[i];
+            py[k] = y[i];
+        }
+
+        for (int s = 0; s < SPLINE_SAMPLES && n < maxOut - 1; s++) {
+            float t = (float)s / SPLINE_SAMPLES;
+            float t2 = t * t, t3 = t2 * t;
+
+            // B-spline basis
+            float b0 = (1 - 3 * t + 3 * t2 - t3) / 6;
+            float b1 = (4 - 6 * t2 + 3 * t3) / 6;
+            float b2 = (1 + 3 * t + 3 * t2 - 3 * t3) / 6;
+            float b3 = t3 / 6;
+
+            float sampleX = b0 * px[0] + b1 * px[1] + b2 * px[2] + b3 * px[3];
+            float sampleY = b0 * py[0] + b1 * py[1] + b2 * py[2] + b3 * py[3];
+
+            // Tripled ends give repeated samples, skip them
+            if (n > 0 && sampleX == outX[n - 1] && sampleY == outY[n - 1]) {
+                continue;
+            }
+
+            outX[n] = sampleX;
+            outY[n] = sampleY;
+            n++;
+        }
+    }
+
+    // End exactly on the last point
+    outX[n] = x[length - 1];
+    outY[n] = y[length - 1];
+    return n + 1;
+}
+
+#endif // PATH_H
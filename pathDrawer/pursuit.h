@@ -0,0 +1,209 @@
+#ifndef PURSUIT_H
+#define PURSUIT_H
+
+#include <FEHIO.h>
+#include <FEHUtility.h>
+#include <FEHMotor.h>
+#include <cmath>
+
+using namespace std;
+
+// Lookahead distance (in)
+#define LOOKAHEAD 4.0
+
+// Cruise and minimum speed (motor percent)
+#define CRUISE_SPEED 60
+#define MIN_SPEED 12
+
+// Slow down within this distance of the end (in)
+#define SLOWDOWN_DISTANCE 6.0
+
+// Done within this distance of the end (in)
+#define END_TOLERANCE 0.5
+
+// Turn in place at this speed when the lookahead point is behind
+#define TURN_SPEED 20
+
+// Control loop period (ms)
+#define LOOP_TIME 20
+
+// Pure pursuit path follower
+// Follows a polyline (inches) without stopping at the points: every loop it picks the
+// point LOOKAHEAD along the path, drives the arc through it and sets wheel speeds
+// from the arc's curvature
+// Pose comes from the encoders, which don't know direction, so each wheel uses the
+// direction it was last driven
+// Robot starts at the first point facing heading (radians)
+class PurePursuit {
+    public:
+        PurePursuit(FEHMotor &left, FEHMotor &right, DigitalEncoder &leftEnc, DigitalEncoder &rightEnc,
+                    float ticksPerInch, float trackWidth);
+        void follow(const float *x, const float *y, int length, float heading);
+    private:
+        FEHMotor &leftBase, &rightBase;
+        DigitalEncoder &leftEnc, &rightEnc;
+        float ticksPerInch, trackWidth;
+        float poseX, poseY, theta;
+        int lastL, lastR;
+        int directionL, directionR;
+        void updatePose();
+        void setWheels(float left, float right);
+        bool lookahead(const float *x, const float *y, int length, int &segment, float &goalX, float &goalY);
+};
+
+// PurePursuit object constructor
+// trackWidth is distance between wheels
+PurePursuit::PurePursuit(FEHMotor &left, FEHMotor &right, DigitalEncoder &leftEnc, DigitalEncoder &rightEnc,
+                         float ticksPerInch, float trackWidth)
+    : leftBase(left), rightBase(right), leftEnc(leftEnc), rightEnc(rightEnc) {
+    this->ticksPerInch = ticksPerInch;
+    this->trackWidth = trackWidth;
+    poseX = 0;
+    poseY = 0;
+    theta = 0;
+    lastL = 0;
+    lastR = 0;
+    directionL = 1;
+    directionR = 1;
+}
+
+// PurePursuit function updatePose
+// Integrates counts since last update
+void PurePursuit::updatePose() {
+    int countsL = leftEnc.Counts(), countsR = rightEnc.Counts();
+
+    float deltaL = (float)directionL * (countsL - lastL) / ticksPerInch;
+    float deltaR = (float)directionR * (countsR - lastR) / ticksPerInch;
+    lastL = countsL;
+    lastR = countsR;
+
+    float distance = (deltaL + deltaR) / 2;
+    float deltaTheta = (deltaR - deltaL) / trackWidth;
+
+    poseX += distance * cos(theta + deltaTheta / 2);
+    poseY += distance * sin(theta + deltaTheta / 2);
+    theta += deltaTheta;
+}
+
+// PurePursuit function setWheels
+// Sets wheel speeds (percent, positive forward) and remembers direction
+void PurePursuit::setWheels(float left, float right) {
+    // Stopped wheel keeps its direction (it may still be coasting)
+    int newL = left > 0 ? 1 : (left < 0 ? -1 : directionL);
+    int newR = right > 0 ? 1 : (right < 0 ? -1 : directionR);
+
+    // Counts so far belong to the old direction
+    if (newL != directionL || newR != directionR) {
+        updatePose();
+    }
+    directionL = newL;
+    directionR = newR;
+
+    leftBase.SetPercent(-left);
+    rightBase.SetPercent(right);
+}
+
+// PurePursuit function lookahead
+// Finds the point LOOKAHEAD from the robot on the path, searching from segment on
+// (segment only moves forward so the robot doesn't jump back on crossing paths)
+// Returns false if the end of the path is within LOOKAHEAD (goal is the last point)
+bool PurePursuit::lookahead(const float *x, const float *y, int length, int &segment, float &goalX, float &goalY) {
+    for (int i = segment; i < length - 1; i++) {
+        float dx = x[i + 1] - x[i], dy = y[i + 1] - y[i];
+        float fx = x[i] - poseX, fy = y[i] - poseY;
+
+        // Intersection of segment with lookahead circle
+        float a = dx * dx + dy * dy;
+        float b = 2 * (fx * dx + fy * dy);
+        float c = fx * fx + fy * fy - LOOKAHEAD * LOOKAHEAD;
+        float discriminant = b * b - 4 * a * c;
+
+        if (a == 0 || discriminant < 0) {
+            continue;
+        }
+
+        // Farther intersection is the one ahead along the segment
+        float t = (-b + sqrt(discriminant)) / (2 * a);
+        if (t >= 0 && t <= 1) {
+            segment = i;
+            goalX = x[i] + t * dx;
+            goalY = y[i] + t * dy;
+            return true;
+        }
+    }
+
+    goalX = x[length - 1];
+    goalY = y[length - 1];
+    return false;
+}
+
+// PurePursuit function follow
+// Drives the whole path continuously and stops at the last point
+void PurePursuit::follow(const float *x, const float *y, int length, float heading) {
+    if (length < 2) {
+        return;
+    }
+
+    // Start at first point
+    poseX = x[0];
+    poseY = y[0];
+    theta = heading;
+    lastL = leftEnc.Counts();
+    lastR = rightEnc.Counts();
+
+    int segment = 0;
+    bool done = false;
+
+    while (!done) {
+        updatePose();
+
+        float goalX, goalY;
+        bool onPath = lookahead(x, y, length, segment, goalX, goalY);
+
+        float toEnd = sqrt((x[length - 1] - poseX) * (x[length - 1] - poseX) +
+                           (y[length - 1] - poseY) * (y[length - 1] - poseY));
+
+        // Goal in robot frame (forward, left)
+        float dx = goalX - poseX, dy = goalY - poseY;
+        float forward = dx * cos(theta) + dy * sin(theta);
+        float left = -dx * sin(theta) + dy * cos(theta);
+
+        if (!onPath && (toEnd < END_TOLERANCE || (forward < 0 && toEnd < LOOKAHEAD / 2))) {
+            // Reached (or passed) the end
+            done = true;
+        }
+        else if (forward < 0) {
+            // Lookahead point behind, turn in place toward it
+            setWheels(left > 0 ? -TURN_SPEED : TURN_SPEED, left > 0 ? TURN_SPEED : -TURN_SPEED);
+        }
+        else {
+            // Curvature of the arc through the goal
+            float distance2 = dx * dx + dy * dy;
+            float curvature = distance2 > 0 ? 2 * left / distance2 : 0;
+
+            // Slow down near the end
+            float speed = CRUISE_SPEED;
+            if (toEnd < SLOWDOWN_DISTANCE) {
+                speed = MIN_SPEED + (CRUISE_SPEED - MIN_SPEED) * toEnd / SLOWDOWN_DISTANCE;
+            }
+
+            float speedL = speed * (1 - curvature * trackWidth / 2);
+            float speedR = speed * (1 + curvature * trackWidth / 2);
+
+            // Scale both down if one is over cruise speed
+            float fastest = fabs(speedL) > fabs(speedR) ? fabs(speedL) : fabs(speedR);
+            if (fastest > CRUISE_SPEED) {
+                speedL *= CRUISE_SPEED / fastest;
+                speedR *= CRUISE_SPEED / fastest;
+            }
+
+            setWheels(speedL, speedR);
+        }
+
+        Sleep(LOOP_TIME);
+    }
+
+    setWheels(0, 0);
+}
+
+#endif // PURSUIT_H
@@ -10,12 +10,20 @@
 #define LOOP_TIME 0.020   // 20 ms, 50 Hz
 
 #define MAX_VELOCITY 5 // Max (reasonable) velocity in in/s
-#define VELOCITY_RANGE 10 // Range of velocity PID in in
+#define VELOCITY_RANGE 10 // Distance from target where velocity starts dropping in in
+#define MAX_ACCEL 20 // Max acceleration in in/s^2
+
+#define SETTLE_RANGE 0.25 // Close enough to target in in
+#define SETTLE_TIME 0.25 // Time close to target before ending in s
 
 #define TICKS_PER_INCH 50 // Conversion from encoder ticks to in
 
 // PID objects with random constants
-PID basePID(0.1, 0, 0, 0), velocityPID(0.3, 0, 0, 0), driftPID(0.1, 0, 0, 0);
+// Wheel velocity loops are percent per in/s with feedforward, drift is in/s per in
+PID leftPID(1.0, 2.0, 0, 2.5), rightPID(1.0, 2.0, 0, 2.5), driftPID(2.0, 0, 0, 0);
+
+// Wheel velocity estimators
+VelocityEstimator leftVelocity, rightVelocity;
 
 // Declare motors
 FEHMotor leftBase(FEHMotor::Motor0, 9);
@@ -60,95 +68,117 @@ float inchToTicks(float target) {
     return target * TICKS_PER_INCH;
 }
 
-// PID control loop
-// target is desired encoder count, vTarget is desired velocity, vRange is active range of velocity PID
-// Velocity PID until some distance to target
-// Position PID when some distance away
-// Drift PID and slew rate are constantly active
-// Ends function 250 ms after gets close
+// Conversion from ticks to inch
+float ticksToInch(float ticks) {
+    return ticks / TICKS_PER_INCH;
+}
+
+// Cascaded control loop
+// target is distance (in), vTarget is cruise velocity (in/s), vRange is distance (in) from target where it starts slowing
+// Outer loop turns position error into a wheel velocity setpoint limited to vTarget, MAX_ACCEL
+// and the velocity it can still stop from
+// Inner loop is velocity PI with feedforward on each wheel's filtered velocity
+// Setpoint goes to 0 at the target, so cruise hands off to position hold without switching loops
+// Encoders don't know direction, so each wheel's counts take the sign of its last output
+// Drift PID trims the wheel setpoints and slew rate is constantly active
+// Ends SETTLE_TIME after getting within SETTLE_RANGE
 // MAX_STEP is slew rate limit (10%)
 // LOOP_TIME is time per update (20 ms)
 void autoDrive(float target, float vTarget = MAX_VELOCITY, float vRange = VELOCITY_RANGE) {
     bool done = false;
-    float closeTime;
-    float driveOut, driftOut;
+    float kPosition = vTarget / vRange;
+    float closeTime = TimeNow();
+    float error, distance, vSet = 0, lastVSet = 0, driftOut;
+    float posL = 0, posR = 0, avgPos, currentTime;
     float outL, outR, lastOutL = 0, lastOutR = 0;
-    float avgEnc, currentTime;
-    float velocity, lastAvgEnc = 0, lastTime = TimeNow() - LOOP_TIME;
-
-    target = inchToTicks(target);
-    vRange = inchToTicks(vRange) * target / fabs(target);
+    float countsL, countsR, lastCountsL = 0, lastCountsR = 0;
 
-    basePID.initialize();
-    velocityPID.initialize();
+    leftPID.initialize();
+    rightPID.initialize();
     driftPID.initialize();
 
-    // Consider allowing for accumulating error
     clearLeftEnc();
     clearRightEnc();
+    leftVelocity.initialize(0);
+    rightVelocity.initialize(0);
 
     while(!done) {
         // Update current time
         currentTime = TimeNow();
 
-        // Update average distance
-        avgEnc = (getLeftEnc() + getRightEnc()) / 2;
-
-        // Calculate velocity
-        velocity = (avgEnc - lastAvgEnc) / (currentTime - lastTime);
-        lastAvgEnc = avgEnc;
-        lastTime = currentTime;
-
-        // Velocity PID
-        if(fabs(target) - fabs(avgEnc) > vRange) {
-            driveOut = velocityPID.calculate(vTarget, velocity);
+        // Signed wheel positions (in)
+        countsL = getLeftEnc();
+        countsR = getRightEnc();
+        posL += (lastOutL < 0 ? -1 : 1) * ticksToInch(countsL - lastCountsL);
+        posR += (lastOutR < 0 ? -1 : 1) * ticksToInch(countsR - lastCountsR);
+        lastCountsL = countsL;
+        lastCountsR = countsR;
+        avgPos = (posL + posR) / 2;
+
+        // Outer loop: velocity setpoint from remaining distance
+        error = target - avgPos;
+        distance = fabs(error);
+        vSet = vTarget;
+        if(kPosition * distance < vSet) {
+            vSet = kPosition * distance;
         }
+        if(sqrt(2 * MAX_ACCEL * distance) < vSet) {
+            vSet = sqrt(2 * MAX_ACCEL * distance);
+        }
+        vSet *= error < 0 ? -1 : 1;
 
-        // Position PID
-        else {
-            driveOut = basePID.calculate(target, avgEnc);
+        // Acceleration limit (slowing down is already limited by the stopping velocity)
+        if(vSet - lastVSet > MAX_ACCEL * LOOP_TIME && vSet > 0) {
+            vSet = lastVSet + MAX_ACCEL * LOOP_TIME;
+        }
+        else if(vSet - lastVSet < -MAX_ACCEL * LOOP_TIME && vSet < 0) {
+            vSet = lastVSet - MAX_ACCEL * LOOP_TIME;
         }
+        lastVSet = vSet;
 
         // Drift PID
-        driftOut = driftPID.calculate(0, getLeftEnc() - getRightEnc());
+        driftOut = driftPID.calculate(0, posL - posR);
 
-        // Calculate motor outputs
-        // Limit driveOut contribution so driftOut can have affect it?
-        outL = driveOut - driftOut;
-        outR = driveOut + driftOut;
+        // Inner loop: wheel velocity PI with feedforward
+        outL = leftPID.calculate(vSet + driftOut, leftVelocity.update(posL));
+        outR = rightPID.calculate(vSet - driftOut, rightVelocity.update(posR));
 
-        // Slew rate limit
+        // Slew rate limit, velocity PI stops integrating while limited
         if(outL - lastOutL > MAX_STEP) {
-            outL = lastOutL + 10;
+            outL = lastOutL + MAX_STEP;
+            leftPID.hold();
         }
         else if(outL - lastOutL < -MAX_STEP) {
-            outL = lastOutL - 10;
+            outL = lastOutL - MAX_STEP;
+            leftPID.hold();
         }
 
         if(outR - lastOutR > MAX_STEP) {
-            outR = lastOutR + 10;
+            outR = lastOutR + MAX_STEP;
+            rightPID.hold();
         }
         else if(outR - lastOutR < -MAX_STEP) {
-            outR = lastOutR - 10;
+            outR = lastOutR - MAX_STEP;
+            rightPID.hold();
         }
 
         // Set motors to output
         driveL(outL);
         driveR(outR);
 
-        // Store output for slew rate
+        // Store output for slew rate and direction
         lastOutL = outL;
         lastOutR = outR;
 
         // Sleep for set time
         Sleep(LOOP_TIME);
 
-        // Loop ends .25 seconds after average gets within 100 ticks
-        if(fabs(target - avgEnc) > 100) {
+        // Loop ends SETTLE_TIME after average gets within SETTLE_RANGE
+        if(distance > SETTLE_RANGE) {
             closeTime = currentTime;
         }
 
-        if(currentTime - closeTime > 250) {
+        if(currentTime - closeTime > SETTLE_TIME) {
             done = true;
         }
     }
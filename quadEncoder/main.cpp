@@ -1,6 +1,7 @@
 #include <FEHLCD.h>
 #include <FEHIO.h>
 #include <FEHUtility.h>
+#include <FEHMotor.h>
 
 #include "derivative.h"
 #include "MK60DZ10.h"
@@ -84,65 +85,300 @@ void enable_irq_q(int irq)
     }
 }
 
-//Interrupt port functions
-long interrupt_counts_q1[32];
-long interrupt_counts_q2[32];
-void portB_isr_q()
-{
-    int pins[8] = { 11, 10, 7, 6, 5, 4, 1, 0 };
+// Vectors in the firmware's table (.interrupts is 0x1e0 bytes in quadEncoder.map)
+#define NUM_VECTORS 120
 
-    for( int i=0 ; i<8 ; i++)
-    {
+typedef void (*ISR)();
+
+// Vector table in RAM
+// The firmware's table is in flash at 0xc000 and points the port vectors at FEHIO's own
+// portX_isr(), which can't be overridden at link time. The table is copied here and VTOR
+// moved to the copy, so the _q ISRs can be written into it
+// VTOR needs the table aligned to its size rounded up to a power of two (512 bytes)
+ISR vector_table_q[ NUM_VECTORS ] __attribute__ ((aligned (512)));
+bool vectors_copied_q = false;
 
-        if( (PORTB_ISFR & (1<<pins[i])) != 0)
+// Points vector irq (INT_xxx) at isr, copies the table to RAM the first time
+// Install before enabling the interrupt
+void install_isr_q( int irq, ISR isr )
+{
+    if( !vectors_copied_q )
+    {
+        ISR *flash = (ISR *)SCB_VTOR;
+        for( int i=0 ; i<NUM_VECTORS ; i++)
         {
-            interrupt_counts_q1[i]++;
-            interrupt_counts_q2[i]++;
-            PORTB_ISFR &= (1<<pins[i]);
+            vector_table_q[i] = flash[i];
         }
+        SCB_VTOR = (unsigned long)vector_table_q;
+        vectors_copied_q = true;
     }
+    vector_table_q[irq] = isr;
 }
-void portC_isr_q()
+
+// True if the active vector table sends irq to isr
+bool isr_installed_q( int irq, ISR isr )
 {
-    int pins[6] = { 0, 1, 8, 9, 10, 11 };
+    ISR *table = (ISR *)SCB_VTOR;
+    return table[irq] == isr;
+}
+
+// Pin of each port bit, -1 if the bit isn't a pin
+// Built from GPIOPorts and GPIOPinNumbers so the ISRs go straight from a flag to a pin
+signed char pin_of_bit_q[5][32];
+bool pin_maps_built_q = false;
 
-    for( int i=0 ; i<6 ; i++)
+void build_pin_maps_q()
+{
+    for( int port=0 ; port<5 ; port++)
     {
-        if( (PORTC_ISFR & (1<<pins[i])) != 0)
+        for( int bit=0 ; bit<32 ; bit++)
         {
-            interrupt_counts_q1[i+8]++;
-            interrupt_counts_q2[i+8]++;
-            PORTC_ISFR &= (1<<pins[i]);
+            pin_of_bit_q[port][bit] = -1;
         }
     }
+    for( int pin=0 ; pin<32 ; pin++)
+    {
+        pin_of_bit_q[GPIOPorts[pin]][GPIOPinNumbers[pin]] = pin;
+    }
+
+    pin_maps_built_q = true;
 }
-void portA_isr_q()
+
+// Port bits of the pins QuadEncoders are set up on
+// The ISRs only handle and clear these flags, the rest belong to whoever set them up
+volatile unsigned long encoder_bits_q[5];
+
+inline void register_pin_q( int pin )
+{
+    encoder_bits_q[GPIOPorts[pin]] |= GPIO_PIN( GPIOPinNumbers[pin] );
+}
+
+// Bus clock driving the PIT (Hz)
+#define BUS_CLOCK 50000000
+
+// No edge for this long means the wheel stopped (s)
+#define EDGE_TIMEOUT 0.5
+
+//Interrupt port functions
+volatile long interrupt_counts_q1[32];
+volatile long interrupt_counts_q2[32];
+
+// Edge timestamps in timer ticks, for velocity from edge to edge periods
+// edge_period_q is 0 until a pin has seen two edges
+volatile unsigned long edge_time_q[32];
+volatile unsigned long edge_period_q[32];
+
+bool edge_timer_started_q = false;
+
+// Free-running edge timer
+// PIT channel 2 counts down from 0xFFFFFFFF at bus clock and wraps every ~85 s,
+// differences of timestamps are right across the wrap
+void start_edge_timer_q()
+{
+    SIM_SCGC6 |= SIM_SCGC6_PIT_MASK;
+    PIT_MCR &= ~PIT_MCR_MDIS_MASK;
+
+    PIT_TCTRL2 = 0;
+    PIT_LDVAL2 = 0xFFFFFFFF;
+    PIT_TCTRL2 = PIT_TCTRL_TEN_MASK;
+
+    edge_timer_started_q = true;
+}
+
+// Timer ticks, counting up
+inline unsigned long edge_timer_q()
+{
+    return ~PIT_CVAL2;
+}
+
+// Quadrature decoding
+// Index is the previous A B state in the high two bits and the new state in the low two,
+// forward is 00 01 11 10. No change and double steps (a missed edge) count 0
+const signed char QUAD_TABLE_Q[16] =
+{
+     0,  1, -1,  0,
+    -1,  0,  0,  1,
+     1,  0,  0, -1,
+     0, -1,  1,  0
+};
+
+#define MAX_QUAD_ENCODERS 4
+
+// Decoder state of one encoder, counts are signed and 4 per encoder cycle
+struct QuadState
+{
+    int pinA, pinB;
+    volatile long counts;
+    volatile unsigned char state;
+};
+
+QuadState quad_states_q[MAX_QUAD_ENCODERS];
+int num_quad_q = 0;
+
+// Encoder index + 1 of each pin, 0 if the pin isn't part of one
+unsigned char quad_of_pin_q[32];
+
+// Level of a pin
+inline int read_pin_q(int pin)
+{
+    unsigned long bit = GPIO_PIN( GPIOPinNumbers[pin] );
+
+    switch( GPIOPorts[pin] )
+    {
+        case PortA:
+            return (GPIOA_PDIR & bit) != 0;
+        case PortB:
+            return (GPIOB_PDIR & bit) != 0;
+        case PortC:
+            return (GPIOC_PDIR & bit) != 0;
+        case PortD:
+            return (GPIOD_PDIR & bit) != 0;
+        default:
+            return (GPIOE_PDIR & bit) != 0;
+    }
+}
+
+// Called from the ISRs on every edge, reads both channels and steps the count
+inline void decode_q(int pin)
+{
+    int e = quad_of_pin_q[pin];
+    if( e == 0 )
+    {
+        return;
+    }
+
+    QuadState &q = quad_states_q[e-1];
+    unsigned char state = (read_pin_q(q.pinA) << 1) | read_pin_q(q.pinB);
+    q.counts += QUAD_TABLE_Q[(q.state << 2) | state];
+    q.state = state;
+}
+
+// Called from the ISRs on every edge with the time the ISR was entered
+inline void record_edge_q(int pin, unsigned long now)
+{
+    if( interrupt_counts_q1[pin] > 1 )
+    {
+        edge_period_q[pin] = now - edge_time_q[pin];
+    }
+    edge_time_q[pin] = now;
+}
+
+// Count thresholds, checked in the ISR on every edge
+// When the count of a pin reaches target the motor (if any) is stopped right away,
+// then reached is set and the callback (if any) is called, still inside the ISR
+typedef void (*ThresholdCallback)(int pin);
+
+struct Threshold
+{
+    long target;
+    FEHMotor *motor;
+    ThresholdCallback callback;
+    volatile bool armed;
+    volatile bool reached;
+};
+
+Threshold thresholds_q[32];
+
+// Called from the ISRs after a count, keep it short
+inline void check_threshold_q(int pin)
 {
-    int pins[11] = { 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7 };
+    Threshold &t = thresholds_q[pin];
 
-    for( int i=0 ; i<11 ; i++)
+    if( t.armed && interrupt_counts_q1[pin] >= t.target )
     {
-        if( (PORTA_ISFR & (1<<pins[i])) != 0)
+        t.armed = false;
+        if( t.motor != 0 )
         {
-            interrupt_counts_q1[i+14]++;
-            interrupt_counts_q2[i+14]++;
-            PORTA_ISFR &= (1<<pins[i]);
+            t.motor->Stop();
+        }
+        t.reached = true;
+        if( t.callback != 0 )
+        {
+            t.callback(pin);
         }
     }
 }
-void portE_isr_q()
+// Sequence lock on everything the ISRs write
+// Incremented before and after each ISR updates counts and edge times, so readers that
+// see the same even value before and after reading got data from one instant
+// Port ISRs have the same priority and don't nest, so one counter covers all of them
+volatile unsigned long edge_sequence_q = 0;
+
+// Handles every flagged pin of a port, only looping over the set bits
+// flags must already be masked to encoder pins, map gives the pin of each port bit
+inline void handle_edges_q(unsigned long flags, const signed char *map, unsigned long now)
 {
-    int pins[5] = { 25, 24, 26, 27, 28 };
+    // Odd while counts are changing
+    edge_sequence_q++;
 
-    for( int i=0 ; i<5 ; i++)
+    while( flags != 0 )
     {
-        if( (PORTE_ISFR & (1<<pins[i])) != 0)
+        int bit = __builtin_ctz(flags);
+        flags &= flags - 1;
+
+        int pin = map[bit];
+        if( pin >= 0 )
         {
-            interrupt_counts_q1[i+25]++;
-            interrupt_counts_q2[i+25]++;
-            PORTE_ISFR &= (1<<pins[i]);
+            interrupt_counts_q1[pin]++;
+            interrupt_counts_q2[pin]++;
+            record_edge_q(pin, now);
+            decode_q(pin);
+            check_threshold_q(pin);
         }
     }
+
+    edge_sequence_q++;
+}
+
+// Encoder flags are read once and cleared with one write (write 1 to clear)
+void portB_isr_q()
+{
+    unsigned long now = edge_timer_q();
+    unsigned long flags = PORTB_ISFR & encoder_bits_q[PortB];
+    handle_edges_q(flags, pin_of_bit_q[PortB], now);
+    PORTB_ISFR = flags;
+}
+void portC_isr_q()
+{
+    unsigned long now = edge_timer_q();
+    unsigned long flags = PORTC_ISFR & encoder_bits_q[PortC];
+    handle_edges_q(flags, pin_of_bit_q[PortC], now);
+    PORTC_ISFR = flags;
+}
+void portA_isr_q()
+{
+    unsigned long now = edge_timer_q();
+    unsigned long flags = PORTA_ISFR & encoder_bits_q[PortA];
+    handle_edges_q(flags, pin_of_bit_q[PortA], now);
+    PORTA_ISFR = flags;
+}
+void portE_isr_q()
+{
+    unsigned long now = edge_timer_q();
+    unsigned long flags = PORTE_ISFR & encoder_bits_q[PortE];
+    handle_edges_q(flags, pin_of_bit_q[PortE], now);
+    PORTE_ISFR = flags;
+}
+
+// Points the port vectors at the ISRs above
+// They replace FEHIO's port ISRs, so FEHIO DigitalEncoders stop counting once a
+// QuadEncoder exists
+bool port_isrs_installed_q = false;
+
+void install_port_isrs_q()
+{
+    install_isr_q( INT_PORTA, portA_isr_q );
+    install_isr_q( INT_PORTB, portB_isr_q );
+    install_isr_q( INT_PORTC, portC_isr_q );
+    install_isr_q( INT_PORTE, portE_isr_q );
+    port_isrs_installed_q = true;
+}
+
+// True if every port vector goes to a _q ISR (checked at startup in main)
+bool port_isrs_check_q()
+{
+    return isr_installed_q( INT_PORTA, portA_isr_q ) && isr_installed_q( INT_PORTB, portB_isr_q )
+        && isr_installed_q( INT_PORTC, portC_isr_q ) && isr_installed_q( INT_PORTE, portE_isr_q );
 }
 
 class QuadEncoder
@@ -152,10 +388,26 @@ public:
     QuadEncoder( FEHIO::FEHIOPin pin1, FEHIO::FEHIOPin pin2);
     int Counts1();
     int Counts2();
+    long Counts();
+    int Index();
     void ResetCounts();
+    void ArmThreshold( long counts, FEHMotor *motor = 0, ThresholdCallback callback = 0 );
+    void DisarmThreshold();
+    bool ThresholdReached();
+    float Period1();
+    float Period2();
+    float Velocity1();
+    float Velocity2();
+    float Position1();
+    float Position2();
 
 private:
     FEHIO::FEHIOPin _pin1, _pin2;
+    int _quad;
+
+    void ReadEdges( int pin, long &counts, unsigned long &time, unsigned long &period );
+    float Period( int pin );
+    float Position( int pin );
 
     QuadEncoder();
     void Initialize( FEHIO::FEHIOPin pin1, FEHIO::FEHIOPin pin2, FEHIO::FEHIOInterruptTrigger trigger );
@@ -182,6 +434,24 @@ void QuadEncoder::Initialize( FEHIO::FEHIOPin pin1, FEHIO::FEHIOPin pin2, FEHIO:
     // store selected pin numbers in class
     _pin1 = pin1;
     _pin2 = pin2;
+
+    if( !pin_maps_built_q )
+    {
+        build_pin_maps_q();
+    }
+    if( !edge_timer_started_q )
+    {
+        start_edge_timer_q();
+    }
+    if( !port_isrs_installed_q )
+    {
+        install_port_isrs_q();
+    }
+
+    // Before the pins can interrupt, so no edge is left uncleared
+    register_pin_q( _pin1 );
+    register_pin_q( _pin2 );
+
     unsigned char trig = (unsigned char)trigger;
     switch( GPIOPorts[ (int)_pin1 ] )
     {
@@ -240,8 +510,8 @@ void QuadEncoder::Initialize( FEHIO::FEHIOPin pin1, FEHIO::FEHIOPin pin2, FEHIO:
         }
         case PortC:
         {
-            PORT_PCR_REG( PORTB_BASE_PTR, GPIOPinNumbers[ (int)_pin2 ] ) = ( 0 | PORT_PCR_MUX( 1 ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK | PORT_PCR_IRQC(trig) | PORT_PCR_PFE_MASK );
-            GPIOB_PDDR &= ~GPIO_PDDR_PDD( GPIO_PIN( GPIOPinNumbers[ (int)_pin2 ] ) );
+            PORT_PCR_REG( PORTC_BASE_PTR, GPIOPinNumbers[ (int)_pin2 ] ) = ( 0 | PORT_PCR_MUX( 1 ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK | PORT_PCR_IRQC(trig) | PORT_PCR_PFE_MASK );
+            GPIOC_PDDR &= ~GPIO_PDDR_PDD( GPIO_PIN( GPIOPinNumbers[ (int)_pin2 ] ) );
             enable_irq_q(INT_PORTC);
             break;
         }
@@ -255,12 +525,26 @@ void QuadEncoder::Initialize( FEHIO::FEHIOPin pin1, FEHIO::FEHIOPin pin2, FEHIO:
         }
         case PortE:
         {
-            PORT_PCR_REG( PORTB_BASE_PTR, GPIOPinNumbers[ (int)_pin2 ] ) = ( 0 | PORT_PCR_MUX( 1 ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK | PORT_PCR_IRQC(trig) | PORT_PCR_PFE_MASK );
-            GPIOB_PDDR &= ~GPIO_PDDR_PDD( GPIO_PIN( GPIOPinNumbers[ (int)_pin2 ] ) );
+            PORT_PCR_REG( PORTE_BASE_PTR, GPIOPinNumbers[ (int)_pin2 ] ) = ( 0 | PORT_PCR_MUX( 1 ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK | PORT_PCR_IRQC(trig) | PORT_PCR_PFE_MASK );
+            GPIOE_PDDR &= ~GPIO_PDDR_PDD( GPIO_PIN( GPIOPinNumbers[ (int)_pin2 ] ) );
             enable_irq_q(INT_PORTE);
             break;
         }
     }
+
+    // Register for quadrature decoding (pin 1 is channel A)
+    _quad = -1;
+    if( num_quad_q < MAX_QUAD_ENCODERS )
+    {
+        _quad = num_quad_q++;
+        QuadState &q = quad_states_q[_quad];
+        q.pinA = _pin1;
+        q.pinB = _pin2;
+        q.counts = 0;
+        q.state = (read_pin_q(_pin1) << 1) | read_pin_q(_pin2);
+        quad_of_pin_q[_pin1] = _quad + 1;
+        quad_of_pin_q[_pin2] = _quad + 1;
+    }
 }
 
 int QuadEncoder::Counts1()
@@ -273,10 +557,390 @@ int QuadEncoder::Counts2()
     return interrupt_counts_q2[_pin2];
 }
 
+// Signed quadrature counts, 4 per encoder cycle, positive when B leads A (swap pins to flip)
+long QuadEncoder::Counts()
+{
+    if( _quad < 0 )
+    {
+        return 0;
+    }
+    return quad_states_q[_quad].counts;
+}
+
+// Slot of this encoder in an EncoderSnapshot, -1 if it isn't decoded
+int QuadEncoder::Index()
+{
+    return _quad;
+}
+
 void QuadEncoder::ResetCounts()
 {
     interrupt_counts_q1[_pin1] = 0;
     interrupt_counts_q2[_pin2] = 0;
+    if( _quad >= 0 )
+    {
+        quad_states_q[_quad].counts = 0;
+    }
+}
+
+// Arms threshold counts from now on the first pin
+// motor is stopped and callback called from the ISR on the edge that reaches it
+void QuadEncoder::ArmThreshold( long counts, FEHMotor *motor, ThresholdCallback callback )
+{
+    Threshold &t = thresholds_q[_pin1];
+
+    // Disarm first so the ISR never sees a half written threshold
+    t.armed = false;
+    t.target = interrupt_counts_q1[_pin1] + counts;
+    t.motor = motor;
+    t.callback = callback;
+    t.reached = false;
+
+    // Already there (counts <= 0), handled here without arming so the ISR can't do it too
+    if( counts <= 0 )
+    {
+        if( motor != 0 )
+        {
+            motor->Stop();
+        }
+        t.reached = true;
+        if( callback != 0 )
+        {
+            callback(_pin1);
+        }
+        return;
+    }
+
+    t.armed = true;
+}
+
+void QuadEncoder::DisarmThreshold()
+{
+    thresholds_q[_pin1].armed = false;
+}
+
+bool QuadEncoder::ThresholdReached()
+{
+    return thresholds_q[_pin1].reached;
+}
+
+// Reads count and edge times of a pin from the same edge (reads again if an ISR ran in between)
+void QuadEncoder::ReadEdges( int pin, long &counts, unsigned long &time, unsigned long &period )
+{
+    unsigned long sequence;
+    do
+    {
+        sequence = edge_sequence_q;
+        counts = interrupt_counts_q1[pin];
+        time = edge_time_q[pin];
+        period = edge_period_q[pin];
+    } while( (sequence & 1) != 0 || sequence != edge_sequence_q );
+}
+
+// Seconds between the last two edges, 0 if stopped
+// Time since the last edge is used once it's longer, so it falls off right away when slowing
+float QuadEncoder::Period( int pin )
+{
+    long counts;
+    unsigned long time, period;
+    ReadEdges( pin, counts, time, period );
+
+    unsigned long since = edge_timer_q() - time;
+    if( period == 0 || since > EDGE_TIMEOUT * BUS_CLOCK )
+    {
+        return 0;
+    }
+    if( since > period )
+    {
+        period = since;
+    }
+    return (float)period / BUS_CLOCK;
+}
+
+// Counts plus the fraction of the current period that has passed
+// Never passes the next count, so it doesn't jump back when the edge comes
+float QuadEncoder::Position( int pin )
+{
+    long counts;
+    unsigned long time, period;
+    ReadEdges( pin, counts, time, period );
+
+    if( period == 0 )
+    {
+        return counts;
+    }
+
+    float fraction = (float)(edge_timer_q() - time) / period;
+    if( fraction > 1 )
+    {
+        fraction = 1;
+    }
+    return counts + fraction;
+}
+
+float QuadEncoder::Period1()
+{
+    return Period( _pin1 );
+}
+
+float QuadEncoder::Period2()
+{
+    return Period( _pin2 );
+}
+
+// Counts per second from the edge period, resolves speeds far below a count per loop
+float QuadEncoder::Velocity1()
+{
+    float period = Period( _pin1 );
+    return period > 0 ? 1 / period : 0;
+}
+
+float QuadEncoder::Velocity2()
+{
+    float period = Period( _pin2 );
+    return period > 0 ? 1 / period : 0;
+}
+
+float QuadEncoder::Position1()
+{
+    return Position( _pin1 );
+}
+
+float QuadEncoder::Position2()
+{
+    return Position( _pin2 );
+}
+
+// Counts of every QuadEncoder from the same instant
+// counts are the signed quadrature counts, edges and edgeTime the edge count and last
+// edge time (timer ticks) of channel A, time is when the snapshot was taken
+// Index with QuadEncoder::Index()
+struct EncoderSnapshot
+{
+    int num;
+    long counts[ MAX_QUAD_ENCODERS ];
+    long edges[ MAX_QUAD_ENCODERS ];
+    unsigned long edgeTime[ MAX_QUAD_ENCODERS ];
+    unsigned long time;
+    unsigned long sequence;
+};
+
+// Takes a snapshot without disabling interrupts, reads again if an ISR ran in between
+// Use it whenever counts are combined (drift, average, odometry) so an edge between
+// two reads can't skew the result
+void encoder_snapshot_q( EncoderSnapshot &snapshot )
+{
+    unsigned long sequence;
+    do
+    {
+        sequence = edge_sequence_q;
+        snapshot.num = num_quad_q;
+        for( int i=0 ; i<num_quad_q ; i++)
+        {
+            int pin = quad_states_q[i].pinA;
+            snapshot.counts[i] = quad_states_q[i].counts;
+            snapshot.edges[i] = interrupt_counts_q1[pin];
+            snapshot.edgeTime[i] = edge_time_q[pin];
+        }
+        snapshot.time = edge_timer_q();
+    } while( (sequence & 1) != 0 || sequence != edge_sequence_q );
+
+    snapshot.sequence = sequence;
+}
+
+// Hardware quadrature decoding
+// FTM1 and FTM2 have a quadrature decoder that counts both phases in hardware (4 per
+// encoder cycle), so counting costs no CPU and can't drop edges at any speed
+// Only these pin pairs can be muxed to a decoder (phase A, phase B, FTM, mux)
+// Uses FTM1/FTM2, they can't drive anything else at the same time
+struct QDPins
+{
+    FEHIO::FEHIOPin pinA, pinB;
+    int ftm;
+    int mux;
+};
+
+#define NUM_QD_PINS 4
+
+const QDPins QD_PINS_Q[ NUM_QD_PINS ] =
+{
+    { FEHIO::P0_7, FEHIO::P0_6, 1, 6 }, // PTB0, PTB1
+    { FEHIO::P2_7, FEHIO::P2_6, 1, 6 }, // PTA8, PTA9
+    { FEHIO::P2_3, FEHIO::P2_2, 1, 7 }, // PTA12, PTA13
+    { FEHIO::P2_5, FEHIO::P2_4, 2, 6 }  // PTA10, PTA11
+};
+
+// Input filter on both phases (4 * value bus clocks)
+#define QD_FILTER 4
+
+// 16 bit counter overflows of each FTM, the ISR extends the count to 32 bits
+volatile long qd_overflows_q[3];
+
+// Called from the FTM ISRs, counter direction at the overflow gives the sign
+inline void qd_overflow_q( FTM_MemMapPtr ftm, int n )
+{
+    if( (FTM_SC_REG(ftm) & FTM_SC_TOF_MASK) != 0 )
+    {
+        if( (FTM_QDCTRL_REG(ftm) & FTM_QDCTRL_TOFDIR_MASK) != 0 )
+        {
+            qd_overflows_q[n]++;
+        }
+        else
+        {
+            qd_overflows_q[n]--;
+        }
+        // Flag clears by writing 0 after reading it set
+        FTM_SC_REG(ftm) &= ~FTM_SC_TOF_MASK;
+    }
+}
+void ftm1_isr_q()
+{
+    qd_overflow_q( FTM1_BASE_PTR, 1 );
+}
+void ftm2_isr_q()
+{
+    qd_overflow_q( FTM2_BASE_PTR, 2 );
+}
+
+// Muxes a pin to a peripheral with the pull up the GPIO pins use
+void set_mux_q( int pin, int mux )
+{
+    switch( GPIOPorts[pin] )
+    {
+        case PortA:
+            PORT_PCR_REG( PORTA_BASE_PTR, GPIOPinNumbers[pin] ) = ( 0 | PORT_PCR_MUX( mux ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK );
+            break;
+        case PortB:
+            PORT_PCR_REG( PORTB_BASE_PTR, GPIOPinNumbers[pin] ) = ( 0 | PORT_PCR_MUX( mux ) | PORT_PCR_PE_MASK | PORT_PCR_PS_MASK );
+            break;
+        default:
+            break;
+    }
+}
+
+class HardwareQuadEncoder
+{
+public:
+    HardwareQuadEncoder( FEHIO::FEHIOPin pinA, FEHIO::FEHIOPin pinB );
+    long Counts();
+    void ResetCounts();
+    bool Valid();
+
+private:
+    FTM_MemMapPtr _ftm;
+    int _n;
+
+    HardwareQuadEncoder();
+};
+
+// Sets up the decoder the pins go to, does nothing if they can't be muxed to one
+HardwareQuadEncoder::HardwareQuadEncoder( FEHIO::FEHIOPin pinA, FEHIO::FEHIOPin pinB )
+{
+    _ftm = 0;
+    _n = 0;
+
+    for( int i=0 ; i<NUM_QD_PINS ; i++)
+    {
+        if( QD_PINS_Q[i].pinA == pinA && QD_PINS_Q[i].pinB == pinB )
+        {
+            _n = QD_PINS_Q[i].ftm;
+            set_mux_q( pinA, QD_PINS_Q[i].mux );
+            set_mux_q( pinB, QD_PINS_Q[i].mux );
+            break;
+        }
+    }
+
+    if( _n == 1 )
+    {
+        SIM_SCGC6 |= SIM_SCGC6_FTM1_MASK;
+        _ftm = FTM1_BASE_PTR;
+    }
+    else if( _n == 2 )
+    {
+        SIM_SCGC3 |= SIM_SCGC3_FTM2_MASK;
+        _ftm = FTM2_BASE_PTR;
+    }
+    else
+    {
+        return;
+    }
+
+    // Full 16 bit range, overflow interrupt extends it
+    FTM_MODE_REG(_ftm) = FTM_MODE_WPDIS_MASK | FTM_MODE_FTMEN_MASK;
+    FTM_CNTIN_REG(_ftm) = 0;
+    FTM_MOD_REG(_ftm) = 0xFFFF;
+    FTM_CNT_REG(_ftm) = 0;
+    FTM_FILTER_REG(_ftm) = FTM_FILTER_CH0FVAL( QD_FILTER ) | FTM_FILTER_CH1FVAL( QD_FILTER );
+    FTM_QDCTRL_REG(_ftm) = FTM_QDCTRL_QUADEN_MASK | FTM_QDCTRL_PHAFLTREN_MASK | FTM_QDCTRL_PHBFLTREN_MASK;
+    qd_overflows_q[_n] = 0;
+
+    // Overflows go to the _q handlers, not the firmware's default FTM vector
+    // A stale TOF is cleared (read then write 0) before the interrupt is enabled
+    int irq = _n == 1 ? INT_FTM1 : INT_FTM2;
+    install_isr_q( irq, _n == 1 ? ftm1_isr_q : ftm2_isr_q );
+    FTM_SC_REG(_ftm) = 0;
+    FTM_SC_REG(_ftm) &= ~FTM_SC_TOF_MASK;
+
+    // Clock is needed for the filters
+    FTM_SC_REG(_ftm) = FTM_SC_CLKS( 1 ) | FTM_SC_TOIE_MASK;
+    enable_irq_q( irq );
+}
+
+HardwareQuadEncoder::HardwareQuadEncoder()
+{
+
+}
+
+// Signed counts, 4 per encoder cycle, positive when A leads B
+// Reads again if the counter overflowed during the read. An overflow the ISR hasn't
+// handled yet (TOF still set, e.g. called with interrupts off) is counted here
+long HardwareQuadEncoder::Counts()
+{
+    if( _ftm == 0 )
+    {
+        return 0;
+    }
+
+    long overflows;
+    unsigned long count, pending;
+    do
+    {
+        overflows = qd_overflows_q[_n];
+        pending = FTM_SC_REG(_ftm) & FTM_SC_TOF_MASK;
+        count = FTM_CNT_REG(_ftm) & 0xFFFF;
+    } while( overflows != qd_overflows_q[_n] || pending != (FTM_SC_REG(_ftm) & FTM_SC_TOF_MASK) );
+
+    if( pending != 0 )
+    {
+        if( (FTM_QDCTRL_REG(_ftm) & FTM_QDCTRL_TOFDIR_MASK) != 0 )
+        {
+            overflows++;
+        }
+        else
+        {
+            overflows--;
+        }
+    }
+
+    return overflows * 65536 + (long)count;
+}
+
+void HardwareQuadEncoder::ResetCounts()
+{
+    if( _ftm == 0 )
+    {
+        return;
+    }
+
+    // Any write loads CNTIN
+    FTM_CNT_REG(_ftm) = 0;
+    qd_overflows_q[_n] = 0;
+}
+
+// False if the pins aren't a decoder pair
+bool HardwareQuadEncoder::Valid()
+{
+    return _ftm != 0;
 }
 
 int main(void)
@@ -287,11 +951,34 @@ int main(void)
     LCD.SetFontColor(FEHLCD::White);
 
     QuadEncoder enc(FEHIO::P0_0, FEHIO::P0_1);
+    QuadEncoder enc2(FEHIO::P0_2, FEHIO::P0_3);
+    HardwareQuadEncoder hwEnc(FEHIO::P0_7, FEHIO::P0_6);
+    FEHMotor motor(FEHMotor::Motor0, 9);
+
+    // Nothing below works unless the port vectors go to the _q ISRs
+    LCD.Write("Port ISRs ");
+    LCD.WriteLine(port_isrs_check_q() ? "ok" : "FAIL");
+
+    // Run motor for 1000 counts, the ISR stops it on the exact edge
+    motor.SetPercent(20);
+    enc.ArmThreshold(1000, &motor);
 
     while(1) {
         LCD.Write(enc.Counts1());
         LCD.Write(" ");
-        LCD.WriteLine(enc.Counts2());
+        LCD.Write(enc.Counts2());
+        LCD.Write(" ");
+        LCD.Write((int)enc.Counts());
+        LCD.WriteLine(enc.ThresholdReached() ? " stopped" : "");
+        LCD.Write(enc.Velocity1());
+        LCD.Write(" ");
+        LCD.WriteLine(enc.Position1());
+        LCD.WriteLine((int)hwEnc.Counts());
+
+        // Difference of two encoders from one snapshot
+        EncoderSnapshot snapshot;
+        encoder_snapshot_q(snapshot);
+        LCD.WriteLine((int)(snapshot.counts[enc.Index()] - snapshot.counts[enc2.Index()]));
 
         Sleep(100);
     }
@@ -0,0 +1,265 @@
+// Runs many simulated courses in parallel and reports how often each task succeeds
+// Build and run from this directory: make campaign && ./campaign
+// Usage: campaign [-n runs] [-s firstSeed] [-j workers] [-t timeLimit] [-w worst]
+// Run i uses seed firstSeed + i, replay one with ./sim -s seed -v
+//
+// Every run is a fork of the untouched parent, so FEHRobot's globals start fresh
+// Workers take the next run from a shared counter, so slow runs don't hold up a queue
+// Tasks are judged by the simulated course (pose, level, arm), not by FEHRobot's code,
+// and only count in order
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "world.h"
+
+// Real time one run may take before it is killed (s)
+#define RUN_TIMEOUT 60
+
+// FEHRobot's main, renamed by the build
+int robot_main();
+
+// How a run ended
+enum {
+    RUN_PENDING,
+    RUN_TIME_LIMIT,
+    RUN_RETURNED,
+    RUN_CRASHED
+};
+
+// One run, in memory shared with the workers
+// Task times are from the start of the run
+struct RunResult {
+    unsigned long seed;
+    int end;
+    int tasksDone;
+    float taskEnd[NUM_COURSE_TASKS];
+    float endTime;
+};
+
+// Shared with the workers
+struct Campaign {
+    volatile int next;
+    RunResult runs[1];
+};
+
+// Runs one course in this (forked) process
+void runOne(const SimParams &params, RunResult &r) {
+    world.reset(params);
+
+    r.end = RUN_RETURNED;
+    try {
+        robot_main();
+    }
+    catch (SimEnd &) {
+        r.end = RUN_TIME_LIMIT;
+    }
+    r.endTime = world.now();
+
+    // Done tasks up to the first one the course didn't see after the one before it
+    r.tasksDone = 0;
+    while (r.tasksDone < NUM_COURSE_TASKS && world.taskTime[r.tasksDone] >= 0 &&
+           (r.tasksDone == 0 || world.taskTime[r.tasksDone] >= r.taskEnd[r.tasksDone - 1])) {
+        r.taskEnd[r.tasksDone] = world.taskTime[r.tasksDone];
+        r.tasksDone++;
+    }
+}
+
+// Takes runs until there are none left, each in a child of this worker
+void worker(Campaign *c, int runs, SimParams params) {
+    while (true) {
+        int i = __sync_fetch_and_add(&c->next, 1);
+        if (i >= runs) {
+            return;
+        }
+
+        RunResult &r = c->runs[i];
+        pid_t pid = fork();
+        if (pid == 0) {
+            alarm(RUN_TIMEOUT);
+            params.seed = r.seed;
+            runOne(params, r);
+            _exit(0);
+        }
+
+        int status = 0;
+        if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            r.end = RUN_CRASHED;
+        }
+    }
+}
+
+// Value at fraction f of sorted values
+float percentile(const float *sorted, int n, float f) {
+    int i = (int)(f * (n - 1) + 0.5);
+    return sorted[i];
+}
+
+// Prints min, median, 90%, 99% and max of values
+void printDistribution(float *values, int n) {
+    if (n == 0) {
+        printf("%8s\n", "-");
+        return;
+    }
+    std::sort(values, values + n);
+    printf("%8.2f%8.2f%8.2f%8.2f%8.2f\n", values[0], percentile(values, n, 0.5),
+           percentile(values, n, 0.9), percentile(values, n, 0.99), values[n - 1]);
+}
+
+// Worse runs finish fewer tasks, then take longer
+bool worseRun(const RunResult *a, const RunResult *b) {
+    if (a->tasksDone != b->tasksDone) {
+        return a->tasksDone < b->tasksDone;
+    }
+    if (a->tasksDone == 0) {
+        return a->seed < b->seed;
+    }
+    return a->taskEnd[a->tasksDone - 1] > b->taskEnd[b->tasksDone - 1];
+}
+
+const char *endName(int end) {
+    switch (end) {
+        case RUN_TIME_LIMIT:
+            return "time limit";
+        case RUN_RETURNED:
+            return "returned";
+        case RUN_CRASHED:
+            return "crashed";
+        default:
+            return "not run";
+    }
+}
+
+void report(Campaign *c, int runs, int worst) {
+    float *values = new float[runs];
+
+    // Success rate, and time each task finished at in the runs that got that far
+    printf("Task             Done    Rate  Finished at (s)\n");
+    printf("%-16s%5s%8s%8s%8s%8s%8s%8s\n", "", "", "", "min", "50%", "90%", "99%", "max");
+    for (int t = 0; t < NUM_COURSE_TASKS; t++) {
+        int n = 0;
+        for (int i = 0; i < runs; i++) {
+            if (c->runs[i].tasksDone > t) {
+                values[n++] = c->runs[i].taskEnd[t];
+            }
+        }
+        printf("%-16s%5d%7.1f%%", COURSE_TASK_NAMES[t], n, 100.0 * n / runs);
+        printDistribution(values, n);
+    }
+
+    // Task durations
+    printf("\nTask duration (s)\n");
+    printf("%-16s%8s%8s%8s%8s%8s\n", "", "min", "50%", "90%", "99%", "max");
+    for (int t = 0; t < NUM_COURSE_TASKS; t++) {
+        int n = 0;
+        for (int i = 0; i < runs; i++) {
+            const RunResult &r = c->runs[i];
+            if (r.tasksDone > t) {
+                values[n++] = r.taskEnd[t] - (t > 0 ? r.taskEnd[t - 1] : 0);
+            }
+        }
+        printf("%-16s", COURSE_TASK_NAMES[t]);
+        printDistribution(values, n);
+    }
+
+    int crashed = 0;
+    for (int i = 0; i < runs; i++) {
+        if (c->runs[i].end == RUN_CRASHED) {
+            crashed++;
+        }
+    }
+    printf("\nCrashed runs: %d\n", crashed);
+
+    // Worst seeds, for replay
+    RunResult **order = new RunResult *[runs];
+    for (int i = 0; i < runs; i++) {
+        order[i] = &c->runs[i];
+    }
+    std::sort(order, order + runs, worseRun);
+
+    printf("\nWorst seeds (replay with ./sim -s seed -v)\n");
+    for (int i = 0; i < worst && i < runs; i++) {
+        const RunResult &r = *order[i];
+        printf("seed %-10lu ", r.seed);
+        if (r.tasksDone < NUM_COURSE_TASKS) {
+            printf("failed %-16s", COURSE_TASK_NAMES[r.tasksDone]);
+        }
+        else {
+            printf("all done at %6.2f s  ", r.taskEnd[NUM_COURSE_TASKS - 1]);
+        }
+        printf(" end %s at %.2f s\n", endName(r.end), r.endTime);
+    }
+
+    delete[] order;
+    delete[] values;
+}
+
+int main(int argc, char **argv) {
+    SimParams params;
+    defaultParams(params);
+
+    int runs = 1000;
+    unsigned long firstSeed = 1;
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int worst = 10;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            runs = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            firstSeed = strtoul(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            workers = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            params.timeLimit = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+            worst = atoi(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "Usage: campaign [-n runs] [-s firstSeed] [-j workers] [-t timeLimit] [-w worst]\n");
+            return 1;
+        }
+    }
+    if (runs < 1 || workers < 1) {
+        fprintf(stderr, "Need at least one run and one worker\n");
+        return 1;
+    }
+
+    // Results live in shared memory so the forked runs can write them
+    size_t size = sizeof(Campaign) + (runs - 1) * sizeof(RunResult);
+    Campaign *c = (Campaign *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (c == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    memset(c, 0, size);
+    for (int i = 0; i < runs; i++) {
+        c->runs[i].seed = firstSeed + i;
+    }
+
+    // Output from forks would repeat anything still buffered
+    fflush(stdout);
+
+    for (int w = 0; w < workers; w++) {
+        if (fork() == 0) {
+            worker(c, runs, params);
+            _exit(0);
+        }
+    }
+    while (wait(0) > 0);
+
+    printf("%d runs, seeds %lu to %lu, %d workers, time limit %.0f s\n\n",
+           runs, firstSeed, firstSeed + runs - 1, workers, params.timeLimit);
+    report(c, runs, worst);
+
+    munmap(c, size);
+    return 0;
+}
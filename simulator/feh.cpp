@@ -0,0 +1,377 @@
+// FEH library on top of the simulated world
+
+#include <FEHLCD.h>
+#include <FEHIO.h>
+#include <FEHUtility.h>
+#include <FEHMotor.h>
+#include <FEHServo.h>
+#include <FEHAccel.h>
+#include <FEHRPS.h>
+#include <FEHBattery.h>
+#include <FEHSD.h>
+#include "MK60DZ10.h"
+#include "world.h"
+#include "replaylog.h"
+#include "recordformat.h"
+#include <cstdio>
+#include <cstdarg>
+
+// Declare library objects
+FEHLCD LCD;
+FEHRPS RPS;
+FEHAccel Accel;
+FEHBattery Battery;
+FEHSD SD;
+
+// Registers
+volatile uint32_t SIM_SCGC6;
+volatile uint32_t PIT_MCR;
+volatile uint32_t PIT_LDVAL3, PIT_TCTRL3, PIT_TFLG3;
+
+// Time of last ResetTime
+double timeZero = 0;
+
+// True if the LCD line has text with no time stamp yet
+bool lineStarted = false;
+
+// Reads come from replayLog instead of world while it is active,
+// and Sleep does nothing since the log already has the time it took
+
+// Utility
+
+void Sleep(int msec) {
+    Sleep(msec / 1000.0);
+}
+
+void Sleep(float sec) {
+    Sleep((double)sec);
+}
+
+void Sleep(double sec) {
+    if (!replayLog.active()) {
+        world.sleep(sec);
+    }
+}
+
+double TimeNow() {
+    if (replayLog.active()) {
+        return replayLog.timeNow();
+    }
+    return world.read() - timeZero;
+}
+
+unsigned int TimeNowSec() {
+    return (unsigned int)TimeNow();
+}
+
+unsigned long TimeNowMSec() {
+    if (replayLog.active()) {
+        return replayLog.timeNowMSec();
+    }
+    return (unsigned long)(TimeNow() * 1000);
+}
+
+void ResetTime() {
+    timeZero = world.now();
+}
+
+// PIT channel 3 counting down at bus clock, wraps like the real one
+uint32_t simTimerCount() {
+    if (replayLog.active()) {
+        return replayLog.timer();
+    }
+    unsigned long long ticks = (unsigned long long)(world.read() * SIM_BUS_CLOCK);
+    return 0xFFFFFFFFu - (uint32_t)ticks;
+}
+
+// IO
+
+AnalogInputPin::AnalogInputPin(FEHIO::FEHIOPin pin) {
+    this->pin = pin;
+}
+
+float AnalogInputPin::Value() {
+    if (replayLog.active()) {
+        return replayLog.value();
+    }
+    return world.analog(pin);
+}
+
+DigitalInputPin::DigitalInputPin(FEHIO::FEHIOPin pin) {
+    this->pin = pin;
+}
+
+bool DigitalInputPin::Value() {
+    return world.digital(pin);
+}
+
+DigitalEncoder::DigitalEncoder(FEHIO::FEHIOPin pin, FEHIO::FEHIOInterruptTrigger trigger) {
+    this->pin = pin;
+}
+
+DigitalEncoder::DigitalEncoder(FEHIO::FEHIOPin pin) {
+    this->pin = pin;
+}
+
+int DigitalEncoder::Counts() {
+    if (replayLog.active()) {
+        return replayLog.counts();
+    }
+    return world.encoderCounts(pin);
+}
+
+void DigitalEncoder::ResetCounts() {
+    world.resetEncoder(pin);
+}
+
+// Motors and servos
+
+FEHMotor::FEHMotor(FEHMotorPort port, float maxVoltage) {
+    this->port = port;
+}
+
+void FEHMotor::SetPercent(signed char percent) {
+    world.setMotor(port, percent);
+}
+
+void FEHMotor::Stop() {
+    world.setMotor(port, 0);
+}
+
+FEHServo::FEHServo(FEHServoPort port) {
+    this->port = port;
+}
+
+void FEHServo::SetMin(int min) {
+}
+
+void FEHServo::SetMax(int max) {
+}
+
+void FEHServo::SetDegree(float degree) {
+    world.setServo(port, degree);
+}
+
+void FEHServo::Off() {
+}
+
+void FEHServo::TouchCalibrate() {
+}
+
+// LCD, text goes to stdout in verbose mode with the time at the start of each line
+
+void lcdText(const char *text, bool newLine) {
+    if (!world.verbose()) {
+        return;
+    }
+    if (!lineStarted) {
+        printf("[%7.3f] ", replayLog.active() ? replayLog.time() : world.now());
+        lineStarted = true;
+    }
+    printf("%s", text);
+    if (newLine) {
+        printf("\n");
+        lineStarted = false;
+    }
+}
+
+void lcdNumber(double d, bool newLine) {
+    char text[32];
+    sprintf(text, "%.3f", d);
+    lcdText(text, newLine);
+}
+
+void lcdInteger(int i, bool newLine) {
+    char text[32];
+    sprintf(text, "%d", i);
+    lcdText(text, newLine);
+}
+
+void FEHLCD::Clear(unsigned int color) {
+}
+
+void FEHLCD::Clear() {
+}
+
+void FEHLCD::SetFontColor(unsigned int color) {
+}
+
+void FEHLCD::SetBackgroundColor(unsigned int color) {
+}
+
+void FEHLCD::Write(const char *str) {
+    lcdText(str, false);
+}
+
+void FEHLCD::Write(int i) {
+    lcdInteger(i, false);
+}
+
+void FEHLCD::Write(float f) {
+    lcdNumber(f, false);
+}
+
+void FEHLCD::Write(double d) {
+    lcdNumber(d, false);
+}
+
+void FEHLCD::Write(bool b) {
+    lcdText(b ? "true" : "false", false);
+}
+
+void FEHLCD::Write(char c) {
+    char text[2] = { c, 0 };
+    lcdText(text, false);
+}
+
+void FEHLCD::WriteLine(const char *str) {
+    lcdText(str, true);
+}
+
+void FEHLCD::WriteLine(int i) {
+    lcdInteger(i, true);
+}
+
+void FEHLCD::WriteLine(float f) {
+    lcdNumber(f, true);
+}
+
+void FEHLCD::WriteLine(double d) {
+    lcdNumber(d, true);
+}
+
+void FEHLCD::WriteLine(bool b) {
+    lcdText(b ? "true" : "false", true);
+}
+
+void FEHLCD::WriteLine(char c) {
+    char text[2] = { c, 0 };
+    lcdText(text, true);
+}
+
+// Status screens are redrawn constantly, WriteRC isn't printed
+
+void FEHLCD::WriteRC(const char *str, int row, int col) {
+}
+
+void FEHLCD::WriteRC(int i, int row, int col) {
+}
+
+void FEHLCD::WriteRC(float f, int row, int col) {
+}
+
+void FEHLCD::WriteRC(double d, int row, int col) {
+}
+
+void FEHLCD::WriteRC(bool b, int row, int col) {
+}
+
+void FEHLCD::WriteRC(char c, int row, int col) {
+}
+
+void FEHLCD::DrawPixel(int x, int y) {
+}
+
+void FEHLCD::DrawLine(int x1, int y1, int x2, int y2) {
+}
+
+void FEHLCD::DrawRectangle(int x, int y, int width, int height) {
+}
+
+void FEHLCD::FillRectangle(int x, int y, int width, int height) {
+}
+
+void FEHLCD::DrawCircle(int x, int y, int r) {
+}
+
+void FEHLCD::FillCircle(int x, int y, int r) {
+}
+
+bool FEHLCD::Touch(float *x, float *y) {
+    if (replayLog.active()) {
+        return replayLog.touch(*x, *y);
+    }
+    return world.touch(*x, *y);
+}
+
+// RPS
+
+void FEHRPS::InitializeTouchMenu() {
+}
+
+float FEHRPS::X() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_RPS_X);
+    }
+    return world.rpsX();
+}
+
+float FEHRPS::Y() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_RPS_Y);
+    }
+    return world.rpsY();
+}
+
+float FEHRPS::Heading() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_RPS_HEADING);
+    }
+    return world.rpsHeading();
+}
+
+int FEHRPS::CurrentRegion() {
+    return 0;
+}
+
+char FEHRPS::CurrentRegionLetter() {
+    return 'A';
+}
+
+// Accelerometer and battery
+
+double FEHAccel::X() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_ACCEL_X);
+    }
+    return world.accelX();
+}
+
+double FEHAccel::Y() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_ACCEL_Y);
+    }
+    return world.accelY();
+}
+
+double FEHAccel::Z() {
+    return world.accelZ();
+}
+
+float FEHBattery::Voltage() {
+    if (replayLog.active()) {
+        return replayLog.value(RECORD_BATTERY);
+    }
+    return world.batteryVoltage();
+}
+
+// SD log
+
+void FEHSD::OpenLog() {
+}
+
+void FEHSD::CloseLog() {
+    if (world.sdFile != 0) {
+        fflush(world.sdFile);
+    }
+}
+
+void FEHSD::Printf(const char *format, ...) {
+    if (world.sdFile == 0) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(world.sdFile, format, args);
+    va_end(args);
+}
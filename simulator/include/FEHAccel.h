@@ -0,0 +1,15 @@
+#ifndef FEHACCEL_H
+#define FEHACCEL_H
+
+// Simulated FEHAccel, g
+
+class FEHAccel {
+    public:
+        double X();
+        double Y();
+        double Z();
+};
+
+extern FEHAccel Accel;
+
+#endif // FEHACCEL_H
@@ -0,0 +1,13 @@
+#ifndef FEHBATTERY_H
+#define FEHBATTERY_H
+
+// Simulated FEHBattery, volts
+
+class FEHBattery {
+    public:
+        float Voltage();
+};
+
+extern FEHBattery Battery;
+
+#endif // FEHBATTERY_H
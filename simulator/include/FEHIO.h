@@ -0,0 +1,52 @@
+#ifndef FEHIO_H
+#define FEHIO_H
+
+// Simulated FEHIO
+
+class FEHIO {
+    public:
+        typedef enum {
+            P0_0 = 0, P0_1, P0_2, P0_3, P0_4, P0_5, P0_6, P0_7,
+            P1_0, P1_1, P1_2, P1_3, P1_4, P1_5, P1_6, P1_7,
+            P2_0, P2_1, P2_2, P2_3, P2_4, P2_5, P2_6, P2_7,
+            P3_0, P3_1, P3_2, P3_3, P3_4, P3_5, P3_6, P3_7,
+            BATTERY_VOLTAGE
+        } FEHIOPin;
+
+        typedef enum {
+            RisingEdge = 0x9,
+            FallingEdge = 0xA,
+            EitherEdge = 0xB
+        } FEHIOInterruptTrigger;
+};
+
+// Analog pin, volts
+class AnalogInputPin {
+    public:
+        AnalogInputPin(FEHIO::FEHIOPin pin);
+        float Value();
+    private:
+        FEHIO::FEHIOPin pin;
+};
+
+// Digital pin, switches read true when released
+class DigitalInputPin {
+    public:
+        DigitalInputPin(FEHIO::FEHIOPin pin);
+        bool Value();
+    private:
+        FEHIO::FEHIOPin pin;
+};
+
+// Digital encoder, counts edges without direction
+class DigitalEncoder {
+    public:
+        DigitalEncoder(FEHIO::FEHIOPin pin, FEHIO::FEHIOInterruptTrigger trigger);
+        DigitalEncoder(FEHIO::FEHIOPin pin);
+        int Counts();
+        void ResetCounts();
+    private:
+        FEHIO::FEHIOPin pin;
+};
+
+#endif // FEHIO_H
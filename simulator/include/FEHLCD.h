@@ -0,0 +1,58 @@
+#ifndef FEHLCD_H
+#define FEHLCD_H
+
+// Simulated FEHLCD
+// Text written with Write and WriteLine goes to stdout in verbose mode, drawing is ignored
+// Touch follows the touch script of the simulation
+
+class FEHLCD {
+    public:
+        typedef enum {
+            Black = 0x000000u,
+            White = 0xFFFFFFu,
+            Red = 0xFF0000u,
+            Green = 0x00FF00u,
+            Blue = 0x0000FFu,
+            Scarlet = 0x990000u,
+            Gray = 0x999999u
+        } FEHLCDColor;
+
+        void Clear(unsigned int color);
+        void Clear();
+        void SetFontColor(unsigned int color);
+        void SetBackgroundColor(unsigned int color);
+
+        void Write(const char *str);
+        void Write(int i);
+        void Write(float f);
+        void Write(double d);
+        void Write(bool b);
+        void Write(char c);
+
+        void WriteLine(const char *str);
+        void WriteLine(int i);
+        void WriteLine(float f);
+        void WriteLine(double d);
+        void WriteLine(bool b);
+        void WriteLine(char c);
+
+        void WriteRC(const char *str, int row, int col);
+        void WriteRC(int i, int row, int col);
+        void WriteRC(float f, int row, int col);
+        void WriteRC(double d, int row, int col);
+        void WriteRC(bool b, int row, int col);
+        void WriteRC(char c, int row, int col);
+
+        void DrawPixel(int x, int y);
+        void DrawLine(int x1, int y1, int x2, int y2);
+        void DrawRectangle(int x, int y, int width, int height);
+        void FillRectangle(int x, int y, int width, int height);
+        void DrawCircle(int x, int y, int r);
+        void FillCircle(int x, int y, int r);
+
+        bool Touch(float *x, float *y);
+};
+
+extern FEHLCD LCD;
+
+#endif // FEHLCD_H
@@ -0,0 +1,22 @@
+#ifndef FEHMOTOR_H
+#define FEHMOTOR_H
+
+// Simulated FEHMotor
+
+class FEHMotor {
+    public:
+        typedef enum {
+            Motor0 = 0,
+            Motor1,
+            Motor2,
+            Motor3
+        } FEHMotorPort;
+
+        FEHMotor(FEHMotorPort port, float maxVoltage);
+        void SetPercent(signed char percent);
+        void Stop();
+    private:
+        FEHMotorPort port;
+};
+
+#endif // FEHMOTOR_H
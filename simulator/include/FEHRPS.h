@@ -0,0 +1,19 @@
+#ifndef FEHRPS_H
+#define FEHRPS_H
+
+// Simulated FEHRPS
+// X and Y in inches, heading in degrees, -1 without signal
+
+class FEHRPS {
+    public:
+        void InitializeTouchMenu();
+        float X();
+        float Y();
+        float Heading();
+        int CurrentRegion();
+        char CurrentRegionLetter();
+};
+
+extern FEHRPS RPS;
+
+#endif // FEHRPS_H
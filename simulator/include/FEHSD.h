@@ -0,0 +1,15 @@
+#ifndef FEHSD_H
+#define FEHSD_H
+
+// Simulated FEHSD, the log goes to the file given with -l (dropped otherwise)
+
+class FEHSD {
+    public:
+        void OpenLog();
+        void CloseLog();
+        void Printf(const char *format, ...);
+};
+
+extern FEHSD SD;
+
+#endif // FEHSD_H
@@ -0,0 +1,29 @@
+#ifndef FEHSERVO_H
+#define FEHSERVO_H
+
+// Simulated FEHServo
+
+class FEHServo {
+    public:
+        typedef enum {
+            Servo0 = 0,
+            Servo1,
+            Servo2,
+            Servo3,
+            Servo4,
+            Servo5,
+            Servo6,
+            Servo7
+        } FEHServoPort;
+
+        FEHServo(FEHServoPort port);
+        void SetMin(int min);
+        void SetMax(int max);
+        void SetDegree(float degree);
+        void Off();
+        void TouchCalibrate();
+    private:
+        FEHServoPort port;
+};
+
+#endif // FEHSERVO_H
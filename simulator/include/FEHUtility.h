@@ -0,0 +1,17 @@
+#ifndef FEHUTILITY_H
+#define FEHUTILITY_H
+
+// Simulated FEHUtility
+// Time is virtual: Sleep advances it instantly and every time read costs a little,
+// so busy waits still move forward
+
+void Sleep(int msec);
+void Sleep(float sec);
+void Sleep(double sec);
+
+double TimeNow();
+unsigned int TimeNowSec();
+unsigned long TimeNowMSec();
+void ResetTime();
+
+#endif // FEHUTILITY_H
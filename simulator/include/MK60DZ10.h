@@ -0,0 +1,24 @@
+#ifndef MK60DZ10_H
+#define MK60DZ10_H
+
+// Simulated MK60DZ10 registers
+// Only the PIT used by FEHRobot/scheduler.h: writes are ignored and the current
+// value of channel 3 counts down from 0xFFFFFFFF at bus clock in virtual time
+
+#include <stdint.h>
+
+extern volatile uint32_t SIM_SCGC6;
+extern volatile uint32_t PIT_MCR;
+extern volatile uint32_t PIT_LDVAL3, PIT_TCTRL3, PIT_TFLG3;
+
+uint32_t simTimerCount();
+
+#define PIT_CVAL3 (simTimerCount())
+
+#define SIM_SCGC6_PIT_MASK 0x800000u
+#define PIT_MCR_MDIS_MASK 0x2u
+#define PIT_MCR_FRZ_MASK 0x1u
+#define PIT_TCTRL_TEN_MASK 0x1u
+#define PIT_TCTRL_TIE_MASK 0x2u
+
+#endif // MK60DZ10_H
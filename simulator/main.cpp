@@ -0,0 +1,77 @@
+// Runs FEHRobot on the simulated course
+// Build and run from this directory: make && ./sim
+// Usage: sim [-s seed] [-t timeLimit] [-v] [-l sdLog] [-p trace]
+// -v prints what the robot writes to the LCD, -l keeps what it writes to SD,
+// -p writes "time x y heading velocityL velocityR" every 10 ms
+// Prints the end pose when the robot returns or the time limit is reached,
+// then when each course task was done
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "world.h"
+
+// FEHRobot's main, renamed by the build
+int robot_main();
+
+int main(int argc, char **argv) {
+    SimParams params;
+    defaultParams(params);
+
+    FILE *trace = 0;
+    bool verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            params.seed = strtoul(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            params.timeLimit = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-l") == 0) {
+            world.sdFile = fopen(argv[++i], "w");
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-p") == 0) {
+            trace = fopen(argv[++i], "w");
+        }
+        else {
+            fprintf(stderr, "Usage: sim [-s seed] [-t timeLimit] [-v] [-l sdLog] [-p trace]\n");
+            return 1;
+        }
+    }
+
+    world.reset(params);
+    world.setVerbose(verbose);
+    world.setTrace(trace);
+
+    const char *end = "returned";
+    try {
+        robot_main();
+    }
+    catch (SimEnd &) {
+        end = "time limit";
+    }
+
+    printf("end %s time %.3f x %.2f y %.2f heading %.1f distance %.1f\n",
+           end, world.now(), world.x, world.y, world.heading, world.distance);
+    for (int i = 0; i < NUM_COURSE_TASKS; i++) {
+        if (world.taskTime[i] >= 0) {
+            printf("%-14s%8.3f\n", COURSE_TASK_NAMES[i], world.taskTime[i]);
+        }
+        else {
+            printf("%-14s%8s\n", COURSE_TASK_NAMES[i], "-");
+        }
+    }
+
+    if (trace != 0) {
+        fclose(trace);
+    }
+    if (world.sdFile != 0) {
+        fclose(world.sdFile);
+    }
+
+    return 0;
+}
@@ -0,0 +1,127 @@
+// Records and replays FEHRobot's hardware reads
+// Build and run from this directory: make replay
+// Usage: replay [-v] log                          plays back a log from the robot's SD card
+//        replay -w log [-s seed] [-t timeLimit] [-v]  records a simulated run to log
+// The robot here is built with RECORD_READS like a recording run on the Proteus
+//
+// Playing back runs the same code on the logged reads at full speed, until the log
+// ends or the code reads something the log doesn't have next
+// The robot records again while it plays back, and that must match the log byte for byte
+// (up to what was still in its buffer when the log ended)
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "world.h"
+#include "replaylog.h"
+
+// FEHRobot's main, renamed by the build
+int robot_main();
+
+// Runs the robot until it returns, runs out of time or the log stops it
+const char *runRobot() {
+    try {
+        robot_main();
+    }
+    catch (SimEnd &) {
+        return replayLog.active() ? replayLog.error() : "time limit";
+    }
+    return "returned";
+}
+
+// Compares what was recorded during playback with the start of the log
+// Returns the number of matching bytes, or -1 if they differ
+long compareLogs(FILE *recorded, const char *logName) {
+    FILE *log = fopen(logName, "r");
+    if (log == 0) {
+        return -1;
+    }
+
+    rewind(recorded);
+    long matched = 0;
+    int c;
+    while ((c = fgetc(recorded)) != EOF) {
+        if (fgetc(log) != c) {
+            matched = -1;
+            break;
+        }
+        matched++;
+    }
+
+    fclose(log);
+    return matched;
+}
+
+int main(int argc, char **argv) {
+    SimParams params;
+    defaultParams(params);
+
+    const char *logName = 0;
+    bool write = false, verbose = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-w") == 0) {
+            write = true;
+            logName = argv[++i];
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            params.seed = strtoul(argv[++i], 0, 10);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-t") == 0) {
+            params.timeLimit = atof(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && logName == 0) {
+            logName = argv[i];
+        }
+        else {
+            logName = 0;
+            break;
+        }
+    }
+    if (logName == 0) {
+        fprintf(stderr, "Usage: replay [-v] log\n       replay -w log [-s seed] [-t timeLimit] [-v]\n");
+        return 1;
+    }
+
+    world.reset(params);
+    world.setVerbose(verbose);
+
+    // Recording a simulated run, the robot's SD log is the file
+    if (write) {
+        world.sdFile = fopen(logName, "w");
+        if (world.sdFile == 0) {
+            perror(logName);
+            return 1;
+        }
+
+        const char *end = runRobot();
+        printf("recorded %ld bytes, end %s time %.3f\n", ftell(world.sdFile), end, world.now());
+        fclose(world.sdFile);
+        return 0;
+    }
+
+    // Playing back, what the robot records again goes to a temporary file
+    if (!replayLog.open(logName)) {
+        perror(logName);
+        return 1;
+    }
+    world.sdFile = tmpfile();
+
+    const char *end = runRobot();
+    printf("replayed %ld reads, %.3f s of timer, end: %s\n", replayLog.records(), replayLog.time(), end);
+
+    long matched = compareLogs(world.sdFile, logName);
+    if (matched < 0) {
+        printf("recorded again: differs from the log\n");
+    }
+    else {
+        printf("recorded again: %ld bytes match the log\n", matched);
+    }
+
+    fclose(world.sdFile);
+    replayLog.close();
+    return matched < 0 ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+#include "replaylog.h"
+#include "world.h"
+#include "recordformat.h"
+#include <cstdlib>
+#include <cstring>
+
+// Declare replay log
+ReplayLog replayLog;
+
+// ReplayLog object constructor
+// Not replaying
+ReplayLog::ReplayLog() {
+    file = 0;
+    message[0] = 0;
+}
+
+// ReplayLog function open
+// Starts replaying fileName, returns false if it can't be read
+bool ReplayLog::open(const char *fileName) {
+    file = fopen(fileName, "r");
+    line[0] = 0;
+    lineNumber = 0;
+    repeats = 0;
+    consumed = 0;
+    ticks = 0;
+    timerRead = false;
+    memset(lastValue, 0, sizeof(lastValue));
+    message[0] = 0;
+    return file != 0;
+}
+
+// ReplayLog function close
+void ReplayLog::close() {
+    if (file != 0) {
+        fclose(file);
+        file = 0;
+    }
+}
+
+// ReplayLog function active
+bool ReplayLog::active() {
+    return file != 0;
+}
+
+// ReplayLog function records
+// Reads played back so far
+long ReplayLog::records() {
+    return consumed;
+}
+
+// ReplayLog function time
+// Time on the recorded timer since its first read (s)
+double ReplayLog::time() {
+    return ticks / SIM_BUS_CLOCK;
+}
+
+// ReplayLog function error
+// Why the replay stopped
+const char *ReplayLog::error() {
+    return message;
+}
+
+// ReplayLog function fail
+// Stops the run
+void ReplayLog::fail(const char *reason, char wanted) {
+    snprintf(message, sizeof(message), "%s at line %ld (wanted %c, log has %.20s)",
+             reason, lineNumber, wanted, line[0] != 0 ? line : "nothing");
+    throw SimEnd();
+}
+
+// ReplayLog function next
+// Text after the letter of the next record, which must be of kind (and letter, unless 0)
+const char *ReplayLog::next(int kind, char letter) {
+    char wanted = letter != 0 ? letter : '?';
+
+    if (repeats > 0) {
+        repeats--;
+    }
+    else {
+        char text[64];
+        if (fgets(text, sizeof(text), file) == 0) {
+            strcpy(line, "");
+            fail("End of log", wanted);
+        }
+        lineNumber++;
+        text[strcspn(text, "\r\n")] = 0;
+
+        // Repeat count applies to the record before it
+        if (text[0] == RECORD_REPEAT) {
+            if (line[0] == 0) {
+                fail("Repeat with no record", wanted);
+            }
+            repeats = atol(text + 1) - 1;
+        }
+        else {
+            strcpy(line, text);
+        }
+    }
+
+    if (recordKind(line[0]) != kind || (letter != 0 && line[0] != letter)) {
+        fail("Replay diverged", wanted);
+    }
+
+    consumed++;
+    return line + 1;
+}
+
+// ReplayLog function timer
+// PIT count, counting down like the real one
+unsigned long ReplayLog::timer() {
+    const char *text = next(RECORD_TICKS, RECORD_TIMER);
+    uint32_t change = strtoul(text, 0, 16);
+    if (timerRead) {
+        ticks += change;
+    }
+    timerRead = true;
+    lastValue[RECORD_TIMER] -= change;
+    return lastValue[RECORD_TIMER];
+}
+
+// ReplayLog function timeNow
+double ReplayLog::timeNow() {
+    const char *text = next(RECORD_MICROS, RECORD_TIME);
+    lastValue[RECORD_TIME] += (int32_t)strtol(text, 0, 10);
+    return lastValue[RECORD_TIME] / 1000000.0;
+}
+
+// ReplayLog function timeNowMSec
+unsigned long ReplayLog::timeNowMSec() {
+    const char *text = next(RECORD_MILLIS, RECORD_TIME_MSEC);
+    lastValue[RECORD_TIME_MSEC] += (int32_t)strtol(text, 0, 10);
+    return lastValue[RECORD_TIME_MSEC];
+}
+
+// ReplayLog function counts
+// Encoder counts, whichever encoder was read
+int ReplayLog::counts() {
+    const char *text = next(RECORD_COUNTS, 0);
+    uint32_t &last = lastValue[(int)line[0]];
+    last += (int32_t)strtol(text, 0, 10);
+    return (int)last;
+}
+
+// ReplayLog function value
+// Analog pin value, whichever pin was read
+float ReplayLog::value() {
+    return value(0);
+}
+
+// ReplayLog function value
+// Float read under letter (0 for any)
+float ReplayLog::value(char letter) {
+    const char *text = next(RECORD_FLOAT, letter);
+    uint32_t &last = lastValue[(int)line[0]];
+    if (text[0] != 0) {
+        last = strtoul(text, 0, 16);
+    }
+
+    FloatBits v;
+    v.bits = last;
+    return v.f;
+}
+
+// ReplayLog function touch
+bool ReplayLog::touch(float &x, float &y) {
+    const char *text = next(RECORD_PRESS, RECORD_TOUCH);
+    if (text[0] != '1') {
+        return false;
+    }
+
+    FloatBits v;
+    char *end;
+    v.bits = strtoul(text + 1, &end, 16);
+    x = v.f;
+    v.bits = strtoul(end + 1, 0, 16);
+    y = v.f;
+    return true;
+}
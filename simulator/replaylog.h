@@ -0,0 +1,47 @@
+#ifndef REPLAYLOG_H
+#define REPLAYLOG_H
+
+#include <cstdio>
+#include <stdint.h>
+
+// Read log recorded by FEHRobot/record.h, played back through the FEH stubs
+// While active, every stubbed hardware read takes the next record instead of asking world,
+// so the robot code sees exactly the values it saw when the log was made
+// A read the log doesn't have next (the code went another way) or the end of the log
+// stops the run with SimEnd, error() says which
+
+class ReplayLog {
+    public:
+        ReplayLog();
+        bool open(const char *fileName);
+        void close();
+        bool active();
+        long records();
+        double time();
+        const char *error();
+
+        // Reads
+        unsigned long timer();
+        double timeNow();
+        unsigned long timeNowMSec();
+        int counts();
+        float value();
+        float value(char letter);
+        bool touch(float &x, float &y);
+    private:
+        FILE *file;
+        char line[64];
+        long lineNumber;
+        long repeats;
+        long consumed;
+        double ticks;
+        bool timerRead;
+        uint32_t lastValue[128];
+        char message[128];
+        const char *next(int kind, char letter);
+        void fail(const char *reason, char wanted);
+};
+
+extern ReplayLog replayLog;
+
+#endif // REPLAYLOG_H
@@ -0,0 +1,568 @@
+// Tunes FEHRobot's motion gains in simulation with CMA-ES
+// Build and run from this directory: make tune && ./tune
+// Usage: tune [-g generations] [-n seeds] [-j workers] [-s seed]
+// Prints the tuned constants for motion.h
+//
+// Each candidate runs a suite of moves like the routes' on every seed, cost is settle time
+// plus weighted overshoot and final error (and heading change for drives)
+// Search is in log gain space so every candidate is positive and steps scale with the gain
+// Like campaign, each evaluation is a fork of the untouched parent, workers share a counter
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "world.h"
+#include "tunegains.h"
+
+#define PI 3.1415926536
+
+// Cost weights: seconds per inch of overshoot and final error, per degree of drive heading change
+#define OVERSHOOT_WEIGHT 2.0
+#define ERROR_WEIGHT 4.0
+#define HEADING_WEIGHT 0.2
+
+// Within this of the target counts as settled (in)
+#define SETTLE_TOLERANCE 0.25
+
+// Time watched after a move returns, so coasting counts (s)
+#define SETTLE_WAIT 0.5
+
+// Virtual time one move may take, and the cost of each move not done when it runs out (s)
+#define MOVE_TIMEOUT 10.0
+#define TIMEOUT_COST 30.0
+
+// Gains are kept in this range
+#define MIN_GAIN 0.05
+#define MAX_GAIN 3.0
+
+// Initial step size (log gain)
+#define INITIAL_SIGMA 0.3
+
+// Real time one evaluation may take before it is killed (s)
+#define EVALUATION_TIMEOUT 60
+
+#define MAX_POPULATION 32
+
+// Gains the robot's motions read
+float tuneGains[NUM_GAINS];
+
+const char *GAIN_NAMES[NUM_GAINS] = { "KP_DRIVE", "KP_TURN", "KP_SWEEP", "KP_DRIFT" };
+
+// Gains in motion.h, where the search starts
+const float START_GAINS[NUM_GAINS] = { 0.4, 0.4, 0.6, 0.5 };
+
+// FEHRobot's moves
+void autoDriveF(float target);
+void autoDriveB(float target);
+void autoTurnL(float target);
+void autoTurnR(float target);
+void autoSweepL(float target);
+void autoSweepR(float target);
+
+// Motion types, progress is measured differently for each
+enum {
+    DRIVE_MOVE,
+    TURN_MOVE,
+    SWEEP_MOVE,
+    NUM_MOVE_TYPES
+};
+
+const char *TYPE_NAMES[NUM_MOVE_TYPES] = { "Drive", "Turn", "Sweep" };
+
+// One move of the suite, started at rest at (x, y, heading)
+// direction is 1 for forward, -1 for backward (drives only)
+struct Move {
+    const char *name;
+    int type;
+    void (*run)(float target);
+    float target;
+    int direction;
+    float x, y, heading;
+};
+
+// Distances from the routes, placed in open floor on the upper level away from the ramps
+const Move SUITE[] = {
+    { "Drive 2.5", DRIVE_MOVE, autoDriveF, 2.5, 1, 18, 42, 90 },
+    { "Drive 12", DRIVE_MOVE, autoDriveF, 12, 1, 18, 42, 90 },
+    { "Drive 24", DRIVE_MOVE, autoDriveF, 24, 1, 18, 42, 90 },
+    { "Back 9", DRIVE_MOVE, autoDriveB, 9, -1, 18, 60, 90 },
+    { "Turn L 5.9", TURN_MOVE, autoTurnL, 5.9, 1, 18, 50, 90 },
+    { "Turn R 2.9", TURN_MOVE, autoTurnR, 2.9, 1, 18, 50, 90 },
+    { "Sweep L 4", SWEEP_MOVE, autoSweepL, 4, 1, 18, 50, 90 },
+    { "Sweep R 6.5", SWEEP_MOVE, autoSweepR, 6.5, 1, 18, 50, 90 }
+};
+
+const int SUITE_LENGTH = sizeof(SUITE) / sizeof(SUITE[0]);
+
+// Totals over the suite for one type of move
+struct TypeCost {
+    float settle, overshoot, error, cost;
+};
+
+// One candidate on one seed, in memory shared with the workers
+struct Job {
+    float gains[NUM_GAINS];
+    unsigned long seed;
+    TypeCost types[NUM_MOVE_TYPES];
+    float cost;
+};
+
+// Shared with the workers
+struct Jobs {
+    volatile int next;
+    Job jobs[1];
+};
+
+// Move in progress, followed by the observer
+const Move *move = 0;
+float trackWidth;
+float startX, startY;
+double startTurned, moveStart;
+float peak, lastOutside;
+
+// Progress toward the target in the units the move uses (in of wheel travel)
+float progress() {
+    if (move->type == DRIVE_MOVE) {
+        float theta = move->heading * PI / 180;
+        return move->direction * ((world.x - startX) * cos(theta) + (world.y - startY) * sin(theta));
+    }
+
+    float radians = fabs(world.turned - startTurned) * PI / 180;
+    if (move->type == TURN_MOVE) {
+        return radians * trackWidth / 2;
+    }
+    return radians * trackWidth;
+}
+
+// Called every physics step
+void observe() {
+    if (move == 0) {
+        return;
+    }
+
+    float p = progress();
+    if (p > peak) {
+        peak = p;
+    }
+    if (fabs(p - move->target) > SETTLE_TOLERANCE) {
+        lastOutside = world.now() - moveStart;
+    }
+    if (world.now() - moveStart > MOVE_TIMEOUT) {
+        throw SimEnd();
+    }
+}
+
+// Runs the suite with the job's gains and seed in this (forked) process
+void evaluate(const SimParams &defaults, Job &job) {
+    SimParams params = defaults;
+    params.seed = job.seed;
+    world.reset(params);
+    world.setObserver(observe);
+    trackWidth = params.trackWidth;
+
+    for (int g = 0; g < NUM_GAINS; g++) {
+        tuneGains[g] = job.gains[g];
+    }
+
+    memset(job.types, 0, sizeof(job.types));
+    job.cost = 0;
+
+    int done = 0;
+    try {
+        for (; done < SUITE_LENGTH; done++) {
+            const Move &m = SUITE[done];
+
+            world.place(m.x, m.y, m.heading);
+            startX = m.x;
+            startY = m.y;
+            startTurned = world.turned;
+            moveStart = world.now();
+            peak = 0;
+            lastOutside = 0;
+            move = &m;
+
+            m.run(m.target);
+            world.sleep(SETTLE_WAIT);
+
+            float overshoot = peak > m.target ? peak - m.target : 0;
+            float error = fabs(progress() - m.target);
+            float cost = lastOutside + OVERSHOOT_WEIGHT * overshoot + ERROR_WEIGHT * error;
+            if (m.type == DRIVE_MOVE) {
+                cost += HEADING_WEIGHT * fabs(world.turned - startTurned);
+            }
+
+            TypeCost &t = job.types[m.type];
+            t.settle += lastOutside;
+            t.overshoot += overshoot;
+            t.error += error;
+            t.cost += cost;
+            job.cost += cost;
+            move = 0;
+        }
+    }
+    catch (SimEnd &) {
+        // Motion left running, the rest of the suite can't be trusted
+        float cost = (SUITE_LENGTH - done) * TIMEOUT_COST;
+        job.types[SUITE[done].type].cost += cost;
+        job.cost += cost;
+    }
+}
+
+// Evaluates jobs [0, count) with workers processes, each job in its own fork
+void runJobs(Jobs *jobs, int count, int workers, const SimParams &params) {
+    jobs->next = 0;
+    fflush(stdout);
+
+    for (int w = 0; w < workers; w++) {
+        if (fork() != 0) {
+            continue;
+        }
+
+        while (true) {
+            int i = __sync_fetch_and_add(&jobs->next, 1);
+            if (i >= count) {
+                _exit(0);
+            }
+
+            Job &job = jobs->jobs[i];
+            pid_t pid = fork();
+            if (pid == 0) {
+                alarm(EVALUATION_TIMEOUT);
+                evaluate(params, job);
+                _exit(0);
+            }
+
+            int status = 0;
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                job.cost = SUITE_LENGTH * TIMEOUT_COST;
+            }
+        }
+    }
+    while (wait(0) > 0);
+}
+
+// Eigen decomposition of symmetric a (n x n, row major) by cyclic Jacobi rotations
+// Eigenvalues go to values, eigenvectors to the columns of vectors
+void eigen(int n, const double *a, double *values, double *vectors) {
+    double m[NUM_GAINS * NUM_GAINS];
+    memcpy(m, a, sizeof(double) * n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            vectors[i * n + j] = i == j;
+        }
+    }
+
+    for (int sweep = 0; sweep < 50; sweep++) {
+        double off = 0;
+        for (int i = 0; i < n; i++) {
+            for (int j = i + 1; j < n; j++) {
+                off += m[i * n + j] * m[i * n + j];
+            }
+        }
+        if (off < 1e-20) {
+            break;
+        }
+
+        for (int p = 0; p < n; p++) {
+            for (int q = p + 1; q < n; q++) {
+                if (m[p * n + q] == 0) {
+                    continue;
+                }
+                double theta = (m[q * n + q] - m[p * n + p]) / (2 * m[p * n + q]);
+                double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+                double c = 1 / sqrt(t * t + 1), s = t * c;
+
+                for (int k = 0; k < n; k++) {
+                    double kp = m[k * n + p], kq = m[k * n + q];
+                    m[k * n + p] = c * kp - s * kq;
+                    m[k * n + q] = s * kp + c * kq;
+                }
+                for (int k = 0; k < n; k++) {
+                    double pk = m[p * n + k], qk = m[q * n + k];
+                    m[p * n + k] = c * pk - s * qk;
+                    m[q * n + k] = s * pk + c * qk;
+                }
+                for (int k = 0; k < n; k++) {
+                    double kp = vectors[k * n + p], kq = vectors[k * n + q];
+                    vectors[k * n + p] = c * kp - s * kq;
+                    vectors[k * n + q] = s * kp + c * kq;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        values[i] = m[i * n + i] > 1e-20 ? m[i * n + i] : 1e-20;
+    }
+}
+
+// Gains for a point in log gain space
+void toGains(const double *x, float *gains) {
+    for (int g = 0; g < NUM_GAINS; g++) {
+        float gain = exp(x[g]);
+        gains[g] = gain < MIN_GAIN ? MIN_GAIN : (gain > MAX_GAIN ? MAX_GAIN : gain);
+    }
+}
+
+// Fills seeds jobs for each candidate
+void fillJobs(Jobs *jobs, const float (*gains)[NUM_GAINS], int candidates, int seeds) {
+    for (int c = 0; c < candidates; c++) {
+        for (int s = 0; s < seeds; s++) {
+            Job &job = jobs->jobs[c * seeds + s];
+            memcpy(job.gains, gains[c], sizeof(job.gains));
+            job.seed = s + 1;
+        }
+    }
+}
+
+// Average cost of a candidate over its seeds
+float candidateCost(Jobs *jobs, int c, int seeds) {
+    float sum = 0;
+    for (int s = 0; s < seeds; s++) {
+        sum += jobs->jobs[c * seeds + s].cost;
+    }
+    return sum / seeds;
+}
+
+// Average per type costs of a candidate over its seeds
+void candidateTypes(Jobs *jobs, int c, int seeds, TypeCost *types) {
+    memset(types, 0, sizeof(TypeCost) * NUM_MOVE_TYPES);
+    for (int s = 0; s < seeds; s++) {
+        for (int t = 0; t < NUM_MOVE_TYPES; t++) {
+            const TypeCost &j = jobs->jobs[c * seeds + s].types[t];
+            types[t].settle += j.settle / seeds;
+            types[t].overshoot += j.overshoot / seeds;
+            types[t].error += j.error / seeds;
+            types[t].cost += j.cost / seeds;
+        }
+    }
+}
+
+void printTypes(const char *name, const TypeCost *types) {
+    printf("%s\n", name);
+    for (int t = 0; t < NUM_MOVE_TYPES; t++) {
+        printf("  %-6s settle %6.2f s  overshoot %5.2f in  error %5.2f in  cost %6.2f\n", TYPE_NAMES[t],
+               types[t].settle, types[t].overshoot, types[t].error, types[t].cost);
+    }
+}
+
+// Candidate order for sorting by cost
+float *sortCosts = 0;
+
+bool cheaper(int a, int b) {
+    return sortCosts[a] < sortCosts[b];
+}
+
+int main(int argc, char **argv) {
+    SimParams params;
+    defaultParams(params);
+
+    int generations = 30;
+    int seeds = 4;
+    int workers = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long searchSeed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 < argc && strcmp(argv[i], "-g") == 0) {
+            generations = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            seeds = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-j") == 0) {
+            workers = atoi(argv[++i]);
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "-s") == 0) {
+            searchSeed = strtoul(argv[++i], 0, 10);
+        }
+        else {
+            fprintf(stderr, "Usage: tune [-g generations] [-n seeds] [-j workers] [-s seed]\n");
+            return 1;
+        }
+    }
+    if (seeds < 1 || workers < 1) {
+        fprintf(stderr, "Need at least one seed and one worker\n");
+        return 1;
+    }
+
+    // CMA-ES constants (Hansen's defaults)
+    const int n = NUM_GAINS;
+    const int lambda = 4 + (int)(3 * log((double)n));
+    const int mu = lambda / 2;
+    double weights[MAX_POPULATION], weightSum = 0, weightSquares = 0;
+    for (int i = 0; i < mu; i++) {
+        weights[i] = log((lambda + 1) / 2.0) - log(i + 1.0);
+        weightSum += weights[i];
+    }
+    for (int i = 0; i < mu; i++) {
+        weights[i] /= weightSum;
+        weightSquares += weights[i] * weights[i];
+    }
+    const double mueff = 1 / weightSquares;
+    const double cc = (4 + mueff / n) / (n + 4 + 2 * mueff / n);
+    const double cs = (mueff + 2) / (n + mueff + 5);
+    const double c1 = 2 / ((n + 1.3) * (n + 1.3) + mueff);
+    const double cmu = std::min(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff));
+    const double damps = 1 + 2 * std::max(0.0, sqrt((mueff - 1) / (n + 1)) - 1) + cs;
+    const double chiN = sqrt((double)n) * (1 - 1.0 / (4 * n) + 1.0 / (21 * n * n));
+
+    // Search state: mean, step size, covariance = B D^2 B^T, evolution paths
+    double mean[NUM_GAINS], sigma = INITIAL_SIGMA;
+    double C[NUM_GAINS * NUM_GAINS], B[NUM_GAINS * NUM_GAINS], D[NUM_GAINS];
+    double pc[NUM_GAINS], ps[NUM_GAINS];
+    for (int i = 0; i < n; i++) {
+        mean[i] = log(START_GAINS[i]);
+        pc[i] = 0;
+        ps[i] = 0;
+        D[i] = 1;
+        for (int j = 0; j < n; j++) {
+            C[i * n + j] = i == j;
+            B[i * n + j] = i == j;
+        }
+    }
+
+    Random random;
+    random.seed(searchSeed, 0);
+
+    size_t size = sizeof(Jobs) + (MAX_POPULATION * seeds - 1) * sizeof(Job);
+    Jobs *jobs = (Jobs *)mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (jobs == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    // Gains in motion.h
+    float start[1][NUM_GAINS];
+    memcpy(start[0], START_GAINS, sizeof(START_GAINS));
+    fillJobs(jobs, start, 1, seeds);
+    runJobs(jobs, seeds, workers, params);
+    TypeCost startTypes[NUM_MOVE_TYPES];
+    candidateTypes(jobs, 0, seeds, startTypes);
+    float startCost = candidateCost(jobs, 0, seeds);
+
+    float best[NUM_GAINS];
+    memcpy(best, START_GAINS, sizeof(best));
+    float bestCost = startCost;
+    TypeCost bestTypes[NUM_MOVE_TYPES];
+    memcpy(bestTypes, startTypes, sizeof(bestTypes));
+
+    printf("%d generations of %d, %d seeds, %d workers\n", generations, lambda, seeds, workers);
+    printf("start cost %.2f\n", startCost);
+
+    for (int gen = 0; gen < generations; gen++) {
+        // Sample x = mean + sigma B D z
+        double x[MAX_POPULATION][NUM_GAINS], y[MAX_POPULATION][NUM_GAINS];
+        float gains[MAX_POPULATION][NUM_GAINS];
+        for (int k = 0; k < lambda; k++) {
+            double z[NUM_GAINS];
+            for (int i = 0; i < n; i++) {
+                z[i] = D[i] * random.gaussian();
+            }
+            for (int i = 0; i < n; i++) {
+                y[k][i] = 0;
+                for (int j = 0; j < n; j++) {
+                    y[k][i] += B[i * n + j] * z[j];
+                }
+                x[k][i] = mean[i] + sigma * y[k][i];
+            }
+            toGains(x[k], gains[k]);
+        }
+
+        fillJobs(jobs, gains, lambda, seeds);
+        runJobs(jobs, lambda * seeds, workers, params);
+
+        float costs[MAX_POPULATION];
+        int order[MAX_POPULATION];
+        for (int k = 0; k < lambda; k++) {
+            costs[k] = candidateCost(jobs, k, seeds);
+            order[k] = k;
+        }
+        sortCosts = costs;
+        std::sort(order, order + lambda, cheaper);
+
+        if (costs[order[0]] < bestCost) {
+            bestCost = costs[order[0]];
+            memcpy(best, gains[order[0]], sizeof(best));
+            candidateTypes(jobs, order[0], seeds, bestTypes);
+        }
+
+        printf("generation %2d  best %.2f  sigma %.3f  gains", gen + 1, costs[order[0]], sigma);
+        for (int g = 0; g < NUM_GAINS; g++) {
+            printf(" %.3f", gains[order[0]][g]);
+        }
+        printf("\n");
+
+        // Recombine the best mu steps
+        double step[NUM_GAINS];
+        for (int i = 0; i < n; i++) {
+            step[i] = 0;
+            for (int k = 0; k < mu; k++) {
+                step[i] += weights[k] * y[order[k]][i];
+            }
+            mean[i] += sigma * step[i];
+        }
+
+        // Step size path uses C^-1/2 step = B D^-1 B^T step
+        double whitened[NUM_GAINS], rotated[NUM_GAINS];
+        for (int j = 0; j < n; j++) {
+            rotated[j] = 0;
+            for (int i = 0; i < n; i++) {
+                rotated[j] += B[i * n + j] * step[i];
+            }
+            rotated[j] /= D[j];
+        }
+        double psLength = 0;
+        for (int i = 0; i < n; i++) {
+            whitened[i] = 0;
+            for (int j = 0; j < n; j++) {
+                whitened[i] += B[i * n + j] * rotated[j];
+            }
+            ps[i] = (1 - cs) * ps[i] + sqrt(cs * (2 - cs) * mueff) * whitened[i];
+            psLength += ps[i] * ps[i];
+        }
+        psLength = sqrt(psLength);
+
+        bool hsig = psLength / sqrt(1 - pow(1 - cs, 2.0 * (gen + 1))) / chiN < 1.4 + 2.0 / (n + 1);
+        for (int i = 0; i < n; i++) {
+            pc[i] = (1 - cc) * pc[i] + (hsig ? sqrt(cc * (2 - cc) * mueff) : 0) * step[i];
+        }
+
+        // Covariance: rank one update from pc, rank mu update from the best steps
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                double rankMu = 0;
+                for (int k = 0; k < mu; k++) {
+                    rankMu += weights[k] * y[order[k]][i] * y[order[k]][j];
+                }
+                C[i * n + j] = (1 - c1 - cmu) * C[i * n + j]
+                    + c1 * (pc[i] * pc[j] + (hsig ? 0 : cc * (2 - cc) * C[i * n + j]))
+                    + cmu * rankMu;
+            }
+        }
+
+        sigma *= exp(cs / damps * (psLength / chiN - 1));
+
+        eigen(n, C, D, B);
+        for (int i = 0; i < n; i++) {
+            D[i] = sqrt(D[i]);
+        }
+    }
+
+    printf("\n");
+    printTypes("Start", startTypes);
+    printTypes("Tuned", bestTypes);
+    printf("\ncost %.2f -> %.2f\n\n", startCost, bestCost);
+
+    printf("// kP for movements (tuned in simulation, %d generations, %d seeds)\n", generations, seeds);
+    for (int g = 0; g < NUM_GAINS; g++) {
+        printf("#define %s %.2f\n", GAIN_NAMES[g], best[g]);
+    }
+
+    munmap(jobs, size);
+    return 0;
+}
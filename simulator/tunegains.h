@@ -0,0 +1,16 @@
+#ifndef TUNEGAINS_H
+#define TUNEGAINS_H
+
+// Gains FEHRobot's motions use in the tune build
+// The Makefile force includes this and defines KP_DRIVE as tuneGains[TUNE_DRIVE] and so on,
+// so tune can change them between runs without rebuilding
+
+#define TUNE_DRIVE 0
+#define TUNE_TURN 1
+#define TUNE_SWEEP 2
+#define TUNE_DRIFT 3
+#define NUM_GAINS 4
+
+extern float tuneGains[NUM_GAINS];
+
+#endif // TUNEGAINS_H
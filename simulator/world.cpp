@@ -0,0 +1,482 @@
+#include "world.h"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+#define PI 3.1415926536
+
+// Declare world
+World world;
+
+const char *const COURSE_TASK_NAMES[NUM_COURSE_TASKS] = {
+    "Token",
+    "DDR light",
+    "DDR button",
+    "Up ramp",
+    "Foosball",
+    "Lever",
+    "Down ramp",
+    "Final button"
+};
+
+// Nominal battery voltage, motor percents are scaled by voltage over this
+#define NOMINAL_VOLTAGE 11.7
+
+void defaultParams(SimParams &p) {
+    p.left.kS = 7;
+    p.left.kV = 3.0;
+    p.left.tau = 0.1;
+    p.right = p.left;
+    p.trackWidth = 7.5;
+    p.ticksPerInch = 2;
+    p.voltage = NOMINAL_VOLTAGE;
+    p.rampLoss = 20;
+
+    p.leftMotor = 0;
+    p.rightMotor = 1;
+    p.leftReversed = true;
+    p.rightReversed = false;
+    p.leftEncoder = 8;
+    p.rightEncoder = 0;
+    p.cdsPin = 7;
+
+    p.startX = 14;
+    p.startY = 10;
+    p.startHeading = 270;
+
+    p.voltageSpread = 0.3;
+    p.startSpread = 0.25;
+    p.startHeadingSpread = 1.0;
+
+    p.rpsPeriod = 0.1;
+    p.rpsNoise = 0.05;
+    p.rpsHeadingNoise = 0.2;
+    p.slip = 0.01;
+
+    p.touchTime = 0.5;
+    p.touchLength = 0.2;
+    p.touchX = 80;
+    p.touchY = 120;
+    p.endTouchDelay = 2.0;
+    p.lightTime = 2.0;
+    p.lightValue = 0.5;
+    p.darkValue = 3.0;
+
+    p.timeLimit = 120;
+    p.seed = 1;
+}
+
+// Random function seed
+// Streams get seeds far apart in the splitmix sequence
+void Random::seed(unsigned long long seed, int stream) {
+    state = seed * 0x9E3779B97F4A7C15ULL + (unsigned long long)stream * 0xD1B54A32D192ED03ULL;
+}
+
+// Random function uniform
+// [0, 1)
+double Random::uniform() {
+    state += 0x9E3779B97F4A7C15ULL;
+    unsigned long long z = state;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    z ^= z >> 31;
+    return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Random function gaussian
+// Standard normal (Box-Muller)
+double Random::gaussian() {
+    double u = uniform(), v = uniform();
+    return sqrt(-2 * log(1 - u)) * cos(2 * PI * v);
+}
+
+// World function reset
+// Robot at start pose, at rest, time 0
+// Battery and start pose are drawn from their own streams so a seed reproduces a run
+void World::reset(const SimParams &params) {
+    p = params;
+    startLightX = p.startX;
+    startLightY = p.startY;
+
+    Random batteryRandom, startRandom;
+    batteryRandom.seed(p.seed, BATTERY_STREAM);
+    startRandom.seed(p.seed, START_STREAM);
+    p.voltage += p.voltageSpread * batteryRandom.gaussian();
+    p.startX += p.startSpread * startRandom.gaussian();
+    p.startY += p.startSpread * startRandom.gaussian();
+    p.startHeading += p.startHeadingSpread * startRandom.gaussian();
+
+    time = 0;
+    stepped = 0;
+    nextPacket = 0;
+    nextTrace = 0;
+    x = p.startX;
+    y = p.startY;
+    heading = p.startHeading;
+    turned = 0;
+    velocityL = 0;
+    velocityR = 0;
+    travelL = 0;
+    travelR = 0;
+    distance = 0;
+    for (int i = 0; i < 8; i++) {
+        servo[i] = 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        motor[i] = 0;
+    }
+    memset(encoderOffset, 0, sizeof(encoderOffset));
+    for (int i = 0; i < NUM_COURSE_TASKS; i++) {
+        taskTime[i] = -1;
+    }
+    foosballSlid = 0;
+    slipRandom.seed(p.seed, SLIP_STREAM);
+    rpsRandom.seed(p.seed, RPS_STREAM);
+    packet();
+}
+
+// World function place
+// Robot picked up and put down at rest, time and encoders keep going
+void World::place(float x, float y, float heading) {
+    this->x = x;
+    this->y = y;
+    this->heading = heading;
+    velocityL = 0;
+    velocityR = 0;
+}
+
+// World function now
+// Virtual time (s)
+double World::now() {
+    return time;
+}
+
+// World function read
+// Virtual time after the cost of reading it
+double World::read() {
+    advance(READ_COST);
+    return time;
+}
+
+// World function sleep
+void World::sleep(double seconds) {
+    if (seconds > 0) {
+        advance(seconds);
+    }
+}
+
+// World function advance
+// Moves time forward and steps physics up to it
+void World::advance(double seconds) {
+    time += seconds;
+
+    while (stepped + PHYSICS_STEP <= time) {
+        step(PHYSICS_STEP);
+        stepped += PHYSICS_STEP;
+
+        if (stepped >= nextPacket) {
+            packet();
+            nextPacket += p.rpsPeriod;
+        }
+
+        if (traceFile != 0 && stepped >= nextTrace) {
+            fprintf(traceFile, "%.3f %.3f %.3f %.2f %.2f %.2f\n", stepped, x, y, heading, velocityL, velocityR);
+            nextTrace += 0.01;
+        }
+
+        if (observer != 0) {
+            observer();
+        }
+    }
+
+    if (time >= p.timeLimit) {
+        throw SimEnd();
+    }
+}
+
+// World function rampAngle
+// Slope under the robot (degrees), 0 off the ramps
+float World::rampAngle() {
+    if (x > RAMP_X0 && x < RAMP_X1 && y > RAMP_Y0 && y < RAMP_Y1) {
+        return RAMP_ANGLE;
+    }
+    if (x > BUMP_X0 && x < BUMP_X1 && y > BUMP_Y0 && y < BUMP_Y1) {
+        return BUMP_ANGLE;
+    }
+    return 0;
+}
+
+// World function pitch
+// Nose up angle (radians), ramps rise toward +y
+float World::pitch() {
+    return asin(sin(rampAngle() * PI / 180) * sin(heading * PI / 180));
+}
+
+// World function roll
+// Left side up angle (radians)
+float World::roll() {
+    return asin(sin(rampAngle() * PI / 180) * cos(heading * PI / 180));
+}
+
+// World function wheelTarget
+// Steady state wheel velocity (in/s) for a motor percent
+float World::wheelTarget(const MotorParams &m, float percent) {
+    float effective = fabs(percent) * p.voltage / NOMINAL_VOLTAGE;
+    if (effective <= m.kS) {
+        return 0;
+    }
+    float velocity = (effective - m.kS) / m.kV;
+    return percent > 0 ? velocity : -velocity;
+}
+
+// World function sideTarget
+// Forward velocity of one side, slowed when climbing (never reversed by the ramp)
+float World::sideTarget(int port, bool reversed, const MotorParams &m) {
+    float target = wheelTarget(m, reversed ? -motor[port] : motor[port]);
+    if (target != 0) {
+        float slowed = target - p.rampLoss * sin(pitch());
+        target = slowed * target > 0 ? slowed : 0;
+    }
+    return target;
+}
+
+// World function step
+// First order wheel dynamics, then differential drive kinematics, then the course
+void World::step(double dt) {
+    float targetL = sideTarget(p.leftMotor, p.leftReversed, p.left);
+    float targetR = sideTarget(p.rightMotor, p.rightReversed, p.right);
+
+    velocityL += (targetL - velocityL) * dt / p.left.tau;
+    velocityR += (targetR - velocityR) * dt / p.right.tau;
+
+    // Wheels turn this much, ground sees it with some slip
+    float deltaL = velocityL * dt, deltaR = velocityR * dt;
+    travelL += fabs(deltaL);
+    travelR += fabs(deltaR);
+    if (p.slip > 0) {
+        deltaL *= 1 + p.slip * slipRandom.gaussian();
+        deltaR *= 1 + p.slip * slipRandom.gaussian();
+    }
+
+    // Ramp is only seen from above, distance along it is longer than across the floor
+    float along = (deltaL + deltaR) / 2 * cos(pitch());
+    float theta = heading * PI / 180;
+    float deltaTheta = (deltaR - deltaL) / p.trackWidth;
+    float lastY = y;
+
+    x += along * cos(theta + deltaTheta / 2);
+    y += along * sin(theta + deltaTheta / 2);
+    heading = fmod(heading + deltaTheta * 180 / PI + 360, 360);
+    turned += deltaTheta * 180 / PI;
+    distance += fabs(along);
+
+    // Walls
+    if (x < ROBOT_RADIUS) {
+        x = ROBOT_RADIUS;
+    }
+    else if (x > COURSE_WIDTH - ROBOT_RADIUS) {
+        x = COURSE_WIDTH - ROBOT_RADIUS;
+    }
+    if (y < ROBOT_RADIUS) {
+        y = ROBOT_RADIUS;
+    }
+    else if (y > COURSE_LENGTH - ROBOT_RADIUS) {
+        y = COURSE_LENGTH - ROBOT_RADIUS;
+    }
+
+    // Step between the levels, only the ramps cross it
+    bool rampSide = (x > RAMP_X0 && x < RAMP_X1) || (x > BUMP_X0 && x < BUMP_X1);
+    if (!rampSide) {
+        if (lastY <= UPPER_Y - ROBOT_RADIUS && y > UPPER_Y - ROBOT_RADIUS) {
+            y = UPPER_Y - ROBOT_RADIUS;
+        }
+        else if (lastY >= UPPER_Y + ROBOT_RADIUS && y < UPPER_Y + ROBOT_RADIUS) {
+            y = UPPER_Y + ROBOT_RADIUS;
+        }
+    }
+
+    // Foosball counters move with the arm
+    if (armDown() && x > FOOSBALL_X0 && x < FOOSBALL_X1 && y > FOOSBALL_Y0) {
+        foosballSlid -= along * cos(theta + deltaTheta / 2);
+    }
+
+    checkTasks();
+}
+
+// World function onLight
+// CdS cell over the start or DDR light
+bool World::onLight() {
+    return hypot(x - startLightX, y - startLightY) < LIGHT_RADIUS || hypot(x - LIGHT_X, y - LIGHT_Y) < LIGHT_RADIUS;
+}
+
+// World function armDown
+bool World::armDown() {
+    return servo[0] > ARM_DOWN_DEGREE;
+}
+
+// World function against
+// Robot pushed against the bottom wall at the button at buttonX
+bool World::against(float buttonX) {
+    return y <= ROBOT_RADIUS + 0.01 && fabs(x - buttonX) < BUTTON_WIDTH / 2;
+}
+
+// World function checkTasks
+// Marks the course tasks done by now, each only once
+void World::checkTasks() {
+    bool done[NUM_COURSE_TASKS];
+    for (int i = 0; i < NUM_COURSE_TASKS; i++) {
+        done[i] = taskTime[i] >= 0;
+    }
+
+    bool red = p.lightValue < RED_LIGHT_BELOW;
+    bool upper = y > UPPER_Y + ROBOT_RADIUS;
+    bool lower = y < UPPER_Y - ROBOT_RADIUS;
+
+    done[COURSE_TOKEN] |= hypot(x - TOKEN_X, y - TOKEN_Y) < TOKEN_RADIUS;
+    bool stopped = fabs(velocityL) < STOPPED_SPEED && fabs(velocityR) < STOPPED_SPEED;
+    done[COURSE_DDR_LIGHT] |= hypot(x - LIGHT_X, y - LIGHT_Y) < LIGHT_RADIUS && time >= p.lightTime && stopped;
+    done[COURSE_DDR_BUTTON] |= against(red ? RED_BUTTON_X : BLUE_BUTTON_X);
+    done[COURSE_UP_RAMP] |= upper;
+    done[COURSE_FOOSBALL] |= foosballSlid >= FOOSBALL_SLIDE;
+    done[COURSE_LEVER] |= armDown() && hypot(x - LEVER_X, y - LEVER_Y) < LEVER_RADIUS;
+    done[COURSE_DOWN_RAMP] |= done[COURSE_UP_RAMP] && lower;
+    done[COURSE_FINAL_BUTTON] |= done[COURSE_DOWN_RAMP] && against(FINAL_BUTTON_X);
+
+    for (int i = 0; i < NUM_COURSE_TASKS; i++) {
+        if (done[i] && taskTime[i] < 0) {
+            taskTime[i] = stepped + PHYSICS_STEP;
+        }
+    }
+}
+
+// World function packet
+// New RPS values with noise
+void World::packet() {
+    packetX = x + p.rpsNoise * rpsRandom.gaussian();
+    packetY = y + p.rpsNoise * rpsRandom.gaussian();
+    packetHeading = fmod(heading + RPS_HEADING_OFFSET + p.rpsHeadingNoise * rpsRandom.gaussian() + 360, 360);
+}
+
+// World function setMotor
+void World::setMotor(int port, float percent) {
+    if (percent > 100) {
+        percent = 100;
+    }
+    else if (percent < -100) {
+        percent = -100;
+    }
+    motor[port] = percent;
+}
+
+// World function setServo
+void World::setServo(int port, float degree) {
+    servo[port] = degree;
+}
+
+// World function encoderCounts
+// Digital encoders count wheel travel without direction
+int World::encoderCounts(int pin) {
+    double travel = 0;
+    if (pin == p.leftEncoder) {
+        travel = travelL;
+    }
+    else if (pin == p.rightEncoder) {
+        travel = travelR;
+    }
+    return (int)(travel * p.ticksPerInch) - encoderOffset[pin];
+}
+
+// World function resetEncoder
+void World::resetEncoder(int pin) {
+    encoderOffset[pin] += encoderCounts(pin);
+}
+
+// World function analog
+// CdS cell follows the light script over the light, other pins read 0
+float World::analog(int pin) {
+    if (pin == p.cdsPin) {
+        return time >= p.lightTime && onLight() ? p.lightValue : p.darkValue;
+    }
+    if (pin == 32) {
+        return batteryVoltage();
+    }
+    return 0;
+}
+
+// World function digital
+// Nothing is pressed
+bool World::digital(int pin) {
+    return true;
+}
+
+// World function touch
+bool World::touch(float &touchX, float &touchY) {
+    double finalButton = taskTime[COURSE_FINAL_BUTTON];
+    bool endTouch = finalButton >= 0 && time >= finalButton + p.endTouchDelay;
+    if ((time >= p.touchTime && time < p.touchTime + p.touchLength) || endTouch) {
+        touchX = p.touchX;
+        touchY = p.touchY;
+        return true;
+    }
+    return false;
+}
+
+// World function rpsX
+float World::rpsX() {
+    return packetX;
+}
+
+// World function rpsY
+float World::rpsY() {
+    return packetY;
+}
+
+// World function rpsHeading
+float World::rpsHeading() {
+    return packetHeading;
+}
+
+// World function accelX
+// Roll (g)
+float World::accelX() {
+    return sin(roll());
+}
+
+// World function accelY
+// Pitch (g)
+float World::accelY() {
+    return sin(pitch());
+}
+
+// World function accelZ
+float World::accelZ() {
+    return cos(pitch()) * cos(roll());
+}
+
+// World function batteryVoltage
+float World::batteryVoltage() {
+    return p.voltage;
+}
+
+// World function setVerbose
+void World::setVerbose(bool verbose) {
+    isVerbose = verbose;
+}
+
+// World function verbose
+bool World::verbose() {
+    return isVerbose;
+}
+
+// World function setTrace
+// Pose and wheel velocities every 10 ms go to trace (0 for none)
+void World::setTrace(FILE *trace) {
+    traceFile = trace;
+}
+
+// World function setObserver
+// observer is called after every physics step (0 for none)
+void World::setObserver(void (*observer)()) {
+    this->observer = observer;
+}
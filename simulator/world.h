@@ -0,0 +1,252 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <cstdio>
+
+// Simulated course and robot
+// The FEH stubs in include/ all go through world, which keeps virtual time and steps
+// a differential drive model that feeds encoder counts, RPS, accelerometer and CdS back
+// Course frame is the RPS frame: x, y in inches, heading in degrees counterclockwise from +x
+
+// Course size (in)
+#define COURSE_WIDTH 36.0
+#define COURSE_LENGTH 72.0
+
+// Ramps: rectangles rising toward +y from the lower level to the upper one (in, degrees)
+// The main ramp is on the right, the short steep bump ramp on the left
+#define RAMP_X0 24.0
+#define RAMP_X1 34.0
+#define RAMP_Y0 24.0
+#define RAMP_Y1 36.0
+#define RAMP_ANGLE 15.0
+#define BUMP_X0 0.0
+#define BUMP_X1 12.0
+#define BUMP_Y0 30.0
+#define BUMP_Y1 36.0
+#define BUMP_ANGLE 25.0
+
+// Upper level starts at UPPER_Y, away from the ramps the step up to it is a wall (in)
+#define UPPER_Y 36.0
+
+// Course elements, placed where FEHRobot's routes take it from the nominal start (in)
+// Token basket, the token drops once the robot backs within TOKEN_RADIUS of it
+#define TOKEN_X 5.0
+#define TOKEN_Y 27.0
+#define TOKEN_RADIUS 2.0
+
+// DDR light on the floor, the CdS cell only sees it or the start light (under the
+// nominal start pose) within LIGHT_RADIUS of them
+#define LIGHT_X 27.0
+#define LIGHT_Y 17.5
+#define LIGHT_RADIUS 2.0
+
+// The robot reads the DDR light once it stops on it, below this wheel speed (in/s)
+#define STOPPED_SPEED 0.5
+
+// Light values under this are red, the rest blue (FEHRobot's BLUE_LIGHT_THRESHOLD)
+#define RED_LIGHT_BELOW 0.95
+
+// Buttons on the bottom wall, pressed by the robot against the wall within
+// BUTTON_WIDTH / 2 of them
+#define RED_BUTTON_X 24.5
+#define BLUE_BUTTON_X 29.5
+#define FINAL_BUTTON_X 6.0
+#define BUTTON_WIDTH 4.0
+
+// Foosball counters along the top, slid by moving at least FOOSBALL_SLIDE toward -x
+// with the arm down inside the strip
+#define FOOSBALL_X0 12.0
+#define FOOSBALL_X1 28.0
+#define FOOSBALL_Y0 62.0
+#define FOOSBALL_SLIDE 8.0
+
+// Lever, pulled by putting the arm down within LEVER_RADIUS of it
+#define LEVER_X 8.5
+#define LEVER_Y 64.5
+#define LEVER_RADIUS 2.0
+
+// Servo 0 past this is the arm down (degrees, FEHRobot's ARM_UP 71 and ARM_DOWN 156)
+#define ARM_DOWN_DEGREE 110
+
+// Course tasks, in the order FEHRobot does them
+enum {
+    COURSE_TOKEN,
+    COURSE_DDR_LIGHT,
+    COURSE_DDR_BUTTON,
+    COURSE_UP_RAMP,
+    COURSE_FOOSBALL,
+    COURSE_LEVER,
+    COURSE_DOWN_RAMP,
+    COURSE_FINAL_BUTTON,
+    NUM_COURSE_TASKS
+};
+
+// Course task names, for reports
+extern const char *const COURSE_TASK_NAMES[NUM_COURSE_TASKS];
+
+// RPS heading minus robot heading (degrees), the QR code is turned on the robot
+// so facing +y reads 0
+#define RPS_HEADING_OFFSET 270
+
+// Distance from robot center to the walls it stops against (in)
+#define ROBOT_RADIUS 4.5
+
+// Physics step (s)
+#define PHYSICS_STEP 0.001
+
+// Virtual time one time read takes (s), keeps busy waits moving
+#define READ_COST 0.000025
+
+// Bus clock of the simulated PIT (Hz)
+#define SIM_BUS_CLOCK 50000000
+
+// Motor model: percent = kS + kV * velocity at steady state (same form as ffgains.h),
+// velocity follows with time constant tau (s)
+struct MotorParams {
+    float kS, kV, tau;
+};
+
+// Everything a run depends on
+struct SimParams {
+    // Drive
+    MotorParams left, right;
+    float trackWidth;
+    float ticksPerInch;
+    float voltage;
+    float rampLoss;
+
+    // Wiring (FEHRobot: left motor reversed on Motor0, encoders on P1_0 and P0_0)
+    int leftMotor, rightMotor;
+    bool leftReversed, rightReversed;
+    int leftEncoder, rightEncoder;
+    int cdsPin;
+
+    // Start pose
+    float startX, startY, startHeading;
+
+    // Spread between runs: battery voltage (V), start position (in) and heading (degrees)
+    // standard deviation, drawn at reset from the run's seed
+    float voltageSpread;
+    float startSpread, startHeadingSpread;
+
+    // Noise: RPS position (in) and heading (degrees) standard deviation,
+    // wheel slip standard deviation as a fraction of distance
+    float rpsPeriod;
+    float rpsNoise, rpsHeadingNoise;
+    float slip;
+
+    // Script: touch at (touchX, touchY) for touchLength starting at touchTime, and again
+    // from endTouchDelay after the final button is pressed (ends FEHRobot's ramming),
+    // start light comes on at lightTime, CdS reads lightValue under it and darkValue otherwise
+    float touchTime, touchLength, touchX, touchY;
+    float endTouchDelay;
+    float lightTime, lightValue, darkValue;
+
+    // Run ends at this virtual time (s)
+    float timeLimit;
+
+    unsigned long seed;
+};
+
+// Fills in FEHRobot's wiring and the nominal robot
+void defaultParams(SimParams &p);
+
+// Thrown from time reads and Sleep once the time limit is reached
+struct SimEnd {
+};
+
+// Random streams of a run
+#define SLIP_STREAM 0
+#define RPS_STREAM 1
+#define BATTERY_STREAM 2
+#define START_STREAM 3
+
+// Deterministic random stream (splitmix64), one per noise source so changing one
+// doesn't shift the others
+class Random {
+    public:
+        void seed(unsigned long long seed, int stream);
+        double uniform();
+        double gaussian();
+    private:
+        unsigned long long state;
+};
+
+class World {
+    public:
+        void reset(const SimParams &params);
+        void place(float x, float y, float heading);
+
+        // Time
+        double now();
+        double read();
+        void sleep(double seconds);
+
+        // Actuators
+        void setMotor(int port, float percent);
+        void setServo(int port, float degree);
+
+        // Sensors
+        int encoderCounts(int pin);
+        void resetEncoder(int pin);
+        float analog(int pin);
+        bool digital(int pin);
+        bool touch(float &x, float &y);
+        float rpsX();
+        float rpsY();
+        float rpsHeading();
+        float accelX();
+        float accelY();
+        float accelZ();
+        float batteryVoltage();
+
+        // Output
+        void setVerbose(bool verbose);
+        bool verbose();
+        void setTrace(FILE *trace);
+        void setObserver(void (*observer)());
+        FILE *sdFile;
+
+        // State, for reports
+        // turned is the total heading change (degrees, counterclockwise, not wrapped)
+        float x, y, heading;
+        double turned;
+        float velocityL, velocityR;
+        float servo[8];
+        float motor[4];
+        double distance;
+
+        // Time each course task was done (s), -1 until it is
+        double taskTime[NUM_COURSE_TASKS];
+    private:
+        SimParams p;
+        double time;
+        double stepped;
+        double nextPacket;
+        float packetX, packetY, packetHeading;
+        double travelL, travelR;
+        int encoderOffset[32];
+        bool isVerbose;
+        FILE *traceFile;
+        double nextTrace;
+        void (*observer)();
+        Random slipRandom, rpsRandom;
+        float startLightX, startLightY;
+        float foosballSlid;
+        void advance(double seconds);
+        void step(double dt);
+        void packet();
+        float pitch();
+        float roll();
+        float rampAngle();
+        bool onLight();
+        bool armDown();
+        bool against(float buttonX);
+        void checkTasks();
+        float wheelTarget(const MotorParams &m, float percent);
+        float sideTarget(int port, bool reversed, const MotorParams &m);
+};
+
+extern World world;
+
+#endif // WORLD_H
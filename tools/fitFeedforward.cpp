@@ -0,0 +1,257 @@
+// Fits feedforward gains (kS, kV, kA per motor and direction) from trueSpeed logs
+// Build on the host: g++ -O2 -o fitFeedforward fitFeedforward.cpp
+// Usage: fitFeedforward [-t ticksPerInch] [-w window] log... > ../FEHRobot/ffgains.h
+// Log lines are "time powerL powerR countsL countsR", tests in one log are separated by time gaps
+// Logs must be from the robot on the floor (trueSpeed runs there), kS, kV and kA of
+// wheels spinning in the air don't describe the loaded drive train
+// Old logs ("time countsL countsR", one power per file) need -s startPower, powers
+// are then startPower, startPower + 1, ... in file order with left positive and right negative
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <vector>
+
+using namespace std;
+
+// Encoder ticks per inch of wheel travel
+#define TICKS_PER_INCH 2.0
+
+// Longer time between samples is a break between tests (s)
+#define MAX_GAP 0.1
+
+// Samples on each side used for derivatives (encoders are coarse, keep it wide)
+#define WINDOW 15
+
+// One log line
+struct Sample {
+    double time;
+    int power[2];
+    long counts[2];
+};
+
+// Least squares accumulator for percent = c + kV v + kA a
+struct Fit {
+    double A[3][3];
+    double b[3];
+    double sumU, sumUU;
+    int n;
+};
+
+// Adds one data point to normal equations
+void addPoint(Fit &f, double u, double v, double a) {
+    double x[3] = { 1, v, a };
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++) {
+            f.A[i][j] += x[i] * x[j];
+        }
+        f.b[i] += x[i] * u;
+    }
+    f.sumU += u;
+    f.sumUU += u * u;
+    f.n++;
+}
+
+// Solves normal equations (Gaussian elimination with pivoting)
+// Returns false if there isn't enough data
+bool solve(Fit f, double out[3]) {
+    int n = 3;
+    // Without acceleration data kA can't be fitted, fix it at 0
+    if (f.A[2][2] < 1e-9) {
+        f.A[2][2] = 1;
+        f.b[2] = 0;
+    }
+
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++) {
+            if (fabs(f.A[row][col]) > fabs(f.A[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(f.A[pivot][col]) < 1e-12) {
+            return false;
+        }
+        for (int j = 0; j < n; j++) {
+            double tmp = f.A[col][j];
+            f.A[col][j] = f.A[pivot][j];
+            f.A[pivot][j] = tmp;
+        }
+        double tmp = f.b[col];
+        f.b[col] = f.b[pivot];
+        f.b[pivot] = tmp;
+
+        for (int row = col + 1; row < n; row++) {
+            double factor = f.A[row][col] / f.A[col][col];
+            for (int j = col; j < n; j++) {
+                f.A[row][j] -= factor * f.A[col][j];
+            }
+            f.b[row] -= factor * f.b[col];
+        }
+    }
+
+    for (int row = n - 1; row >= 0; row--) {
+        double sum = f.b[row];
+        for (int j = row + 1; j < n; j++) {
+            sum -= f.A[row][j] * out[j];
+        }
+        out[row] = sum / f.A[row][row];
+    }
+    return true;
+}
+
+// Reads one log, returns number of samples
+int readLog(const char *name, int startPower, int index, vector<Sample> &samples) {
+    FILE *file = fopen(name, "r");
+    if (file == 0) {
+        fprintf(stderr, "Can't open %s\n", name);
+        return 0;
+    }
+
+    char line[256];
+    int count = 0;
+    while (fgets(line, sizeof(line), file) != 0) {
+        Sample s;
+        if (startPower == 0) {
+            if (sscanf(line, "%lf %d %d %ld %ld", &s.time, &s.power[0], &s.power[1], &s.counts[0], &s.counts[1]) != 5) {
+                continue;
+            }
+        }
+        else {
+            if (sscanf(line, "%lf %ld %ld", &s.time, &s.counts[0], &s.counts[1]) != 3) {
+                continue;
+            }
+            s.power[0] = startPower + index;
+            s.power[1] = -(startPower + index);
+        }
+        samples.push_back(s);
+        count++;
+    }
+
+    fclose(file);
+    return count;
+}
+
+// Adds every usable sample of one log to the fits
+// Velocity is the count rate signed by the commanded direction (encoders don't know it)
+void fitLog(const vector<Sample> &s, double ticksPerInch, int window, Fit fits[2][2]) {
+    int n = s.size();
+    vector<double> velocity[2];
+    velocity[0].assign(n, 0);
+    velocity[1].assign(n, 0);
+    vector<bool> valid(n, false);
+
+    for (int i = window; i < n - window; i++) {
+        double dt = s[i + window].time - s[i - window].time;
+        if (dt <= 0) {
+            continue;
+        }
+
+        valid[i] = true;
+
+        // Derivatives can't span a break between tests
+        for (int k = i - window; k < i + window; k++) {
+            if (s[k + 1].time - s[k].time > MAX_GAP) {
+                valid[i] = false;
+            }
+        }
+
+        for (int m = 0; m < 2; m++) {
+            // Direction must not change inside the window
+            int sign = s[i].power[m] > 0 ? 1 : (s[i].power[m] < 0 ? -1 : 0);
+            for (int k = i - window; k <= i + window; k++) {
+                int other = s[k].power[m] > 0 ? 1 : (s[k].power[m] < 0 ? -1 : 0);
+                if (other != sign || sign == 0) {
+                    valid[i] = false;
+                }
+            }
+            velocity[m][i] = sign * (s[i + window].counts[m] - s[i - window].counts[m]) / dt / ticksPerInch;
+        }
+    }
+
+    for (int i = 2 * window; i < n - 2 * window; i++) {
+        if (!valid[i] || !valid[i - window] || !valid[i + window]) {
+            continue;
+        }
+        double dt = s[i + window].time - s[i - window].time;
+
+        for (int m = 0; m < 2; m++) {
+            double v = velocity[m][i];
+            double a = (velocity[m][i + window] - velocity[m][i - window]) / dt;
+            int direction = s[i].power[m] > 0 ? 0 : 1;
+            addPoint(fits[m][direction], s[i].power[m], v, a);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    double ticksPerInch = TICKS_PER_INCH;
+    int window = WINDOW;
+    int startPower = 0;
+    int first = 1;
+
+    while (first < argc && argv[first][0] == '-') {
+        if (first + 1 >= argc) {
+            break;
+        }
+        if (strcmp(argv[first], "-t") == 0) {
+            ticksPerInch = atof(argv[first + 1]);
+        }
+        else if (strcmp(argv[first], "-w") == 0) {
+            window = atoi(argv[first + 1]);
+        }
+        else if (strcmp(argv[first], "-s") == 0) {
+            startPower = atoi(argv[first + 1]);
+        }
+        first += 2;
+    }
+
+    if (first >= argc) {
+        fprintf(stderr, "Usage: fitFeedforward [-t ticksPerInch] [-w window] [-s startPower] log...\n");
+        return 1;
+    }
+
+    Fit fits[2][2];
+    memset(fits, 0, sizeof(fits));
+
+    for (int i = first; i < argc; i++) {
+        vector<Sample> samples;
+        readLog(argv[i], startPower, i - first, samples);
+        fitLog(samples, ticksPerInch, window, fits);
+    }
+
+    const char *motors[2] = { "LEFT", "RIGHT" };
+    const char *directions[2] = { "POS", "NEG" };
+
+    printf("#ifndef FFGAINS_H\n#define FFGAINS_H\n\n");
+    printf("// Feedforward gains\n");
+    printf("// Generated by tools/fitFeedforward from trueSpeed logs (robot on the floor), regenerate with\n");
+    printf("// fitFeedforward logs... > FEHRobot/ffgains.h\n");
+    printf("// kS percent, kV percent per in/s, kA percent per in/s^2\n");
+    printf("// POS/NEG is the sign of the motor percent\n\n");
+
+    for (int m = 0; m < 2; m++) {
+        for (int d = 0; d < 2; d++) {
+            Fit &f = fits[m][d];
+            double gains[3] = { 0, 0, 0 };
+
+            if (f.n < 3 || !solve(f, gains)) {
+                fprintf(stderr, "%s %s: not enough data (%d samples)\n", motors[m], directions[d], f.n);
+                printf("// %s %s: not enough data\n", motors[m], directions[d]);
+            }
+            else {
+                fprintf(stderr, "%s %s: %d samples\n", motors[m], directions[d], f.n);
+            }
+
+            // Intercept is kS in the direction of the percent
+            double kS = d == 0 ? gains[0] : -gains[0];
+            printf("#define %s_KS_%s %.3f\n", motors[m], directions[d], kS);
+            printf("#define %s_KV_%s %.3f\n", motors[m], directions[d], gains[1]);
+            printf("#define %s_KA_%s %.3f\n", motors[m], directions[d], gains[2]);
+        }
+    }
+
+    printf("\n#endif // FFGAINS_H\n");
+    return 0;
+}
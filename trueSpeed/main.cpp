@@ -5,6 +5,50 @@
 #include <FEHServo.h>
 #include <FEHAccel.h>
 #include <FEHSD.h>
+#include <cmath>
+
+// Logging rate (Hz) and samples per test
+#define SAMPLE_RATE 100
+#define MAX_SAMPLES 1000
+
+// Conversion from ticks to inches
+#define TICKS_PER_INCH 2
+
+// Runs on the floor so the gains include the robot's weight and the wheels' rolling load
+// Needs this much clear floor in front of and behind the robot (in)
+// Each test is run forward then backward so the robot ends up about where it started,
+// and power is cut for the rest of a test once it has gone this far less STOP_DISTANCE
+#define RUN_LENGTH 36
+
+// Distance the robot can coast after the power is cut (in)
+#define STOP_DISTANCE 6
+
+// Ramp test: 0 to RAMP_POWER over RAMP_TIME seconds
+#define RAMP_POWER 60
+#define RAMP_TIME 4.0
+
+// Step test: each power is its own run, held for STEP_TIME, then REST_TIME at 0
+#define NUM_STEPS 6
+#define STEP_TIME 1.0
+#define REST_TIME 0.5
+
+// Steady state is the average over the end of each step (s)
+#define STEADY_TIME 0.4
+
+// Chirp test: CHIRP_OFFSET +- CHIRP_AMPLITUDE, frequency sweeping up over CHIRP_TIME
+#define CHIRP_OFFSET 35
+#define CHIRP_AMPLITUDE 20
+#define CHIRP_START 0.5
+#define CHIRP_END 5.0
+#define CHIRP_TIME 4.0
+
+// Counts that mean the wheel is turning
+#define MOVING_COUNTS 2
+
+// Samples in the (trailing) velocity window for the time constant
+#define VELOCITY_WINDOW 5
+
+#define PI 3.1415926536
 
 // Declare motors
 FEHMotor leftBase(FEHMotor::Motor0, 9);
@@ -14,52 +58,316 @@ FEHMotor rightBase(FEHMotor::Motor1, 9);
 DigitalEncoder leftEnc(FEHIO::P0_1);
 DigitalEncoder rightEnc(FEHIO::P1_0);
 
+// Step powers
+const int STEP_POWERS[NUM_STEPS] = { 20, 35, 50, 65, 80, 100 };
+
+// Test types
+enum {
+    RAMP_TEST,
+    STEP_TEST,
+    CHIRP_TEST
+};
+
+// One sample
+struct Sample {
+    float time;
+    signed char powerL, powerR;
+    int countsL, countsR;
+};
+
+// Samples of the current test, written to SD after the test so logging doesn't disturb timing
+Sample samples[MAX_SAMPLES];
+int numSamples = 0;
+
+// Time the current test's power was cut for reaching RUN_LENGTH (test length if it wasn't)
+float cutTime = 0;
+
+// Results, index 0 is forward and 1 is backward
+// Step time constants are 0 where the wheel didn't move
+float deadBandL[2], deadBandR[2];
+float velocityL[2][NUM_STEPS], velocityR[2][NUM_STEPS];
+float stepTauL[2][NUM_STEPS], stepTauR[2][NUM_STEPS];
+float timeConstantL[2], timeConstantR[2];
+
+// Test length in seconds
+float testLength(int test) {
+    switch (test) {
+        case RAMP_TEST:
+            return RAMP_TIME;
+        case STEP_TEST:
+            return STEP_TIME + REST_TIME;
+        default:
+            return CHIRP_TIME;
+    }
+}
+
+// Power of a test at time t (positive is forward), step is the step test's power index
+int testPower(int test, int step, float t) {
+    switch (test) {
+        case RAMP_TEST:
+            return RAMP_POWER * t / RAMP_TIME;
+        case STEP_TEST:
+            return t < STEP_TIME ? STEP_POWERS[step] : 0;
+        default: {
+            // Linear chirp, phase is the integral of frequency
+            float rate = (CHIRP_END - CHIRP_START) / CHIRP_TIME;
+            float phase = 2 * PI * (CHIRP_START * t + rate * t * t / 2);
+            return CHIRP_OFFSET + CHIRP_AMPLITUDE * sin(phase);
+        }
+    }
+}
+
+// Runs one test at a fixed rate, storing samples
+// direction is 1 for forward, -1 for backward
+// Once the robot has gone RUN_LENGTH - STOP_DISTANCE the power is 0 (and logged as 0) for the rest of the test
+void runTest(int test, int step, int direction) {
+    unsigned long period = 1000 / SAMPLE_RATE;
+    unsigned long start = TimeNowMSec();
+    unsigned long next = start;
+    float length = testLength(test);
+    int startL = leftEnc.Counts(), startR = rightEnc.Counts();
+
+    numSamples = 0;
+    cutTime = length;
+
+    while (numSamples < MAX_SAMPLES) {
+        // Wait for next sample time (deadline based so the rate doesn't drift)
+        while ((long)(TimeNowMSec() - next) < 0);
+        next += period;
+
+        float t = (TimeNowMSec() - start) / 1000.0;
+        if (t > length) {
+            break;
+        }
+
+        // Encoders only count up, travel is the same either way
+        float travel = (leftEnc.Counts() - startL + rightEnc.Counts() - startR) / 2.0 / TICKS_PER_INCH;
+        if (cutTime >= length && travel >= RUN_LENGTH - STOP_DISTANCE) {
+            cutTime = t;
+        }
+
+        int power = t < cutTime ? direction * testPower(test, step, t) : 0;
+        leftBase.SetPercent(power);
+        rightBase.SetPercent(-power);
+
+        Sample &s = samples[numSamples++];
+        s.time = t;
+        s.powerL = power;
+        s.powerR = -power;
+        s.countsL = leftEnc.Counts();
+        s.countsR = rightEnc.Counts();
+    }
+
+    leftBase.SetPercent(0);
+    rightBase.SetPercent(0);
+}
+
+// Writes samples to the open log
+// Same format as the old sweep with powers added, read by tools/fitFeedforward
+void writeSamples(float offset) {
+    for (int i = 0; i < numSamples; i++) {
+        Sample &s = samples[i];
+        SD.Printf("%f %d %d %d %d\n", offset + s.time, s.powerL, s.powerR, s.countsL, s.countsR);
+    }
+}
+
+// Velocity (in/s) of one side over the window ending at sample i
+// Uses only samples up to i, it is the average velocity at velocityTime(i)
+float velocity(int i, bool left) {
+    int first = i - VELOCITY_WINDOW < 0 ? 0 : i - VELOCITY_WINDOW;
+    if (i <= first) {
+        return 0;
+    }
+
+    int counts = left ? samples[i].countsL - samples[first].countsL : samples[i].countsR - samples[first].countsR;
+    return counts / (samples[i].time - samples[first].time) / TICKS_PER_INCH;
+}
+
+// Middle of the window velocity(i) averages over, so its lag can be taken out
+float velocityTime(int i) {
+    int first = i - VELOCITY_WINDOW < 0 ? 0 : i - VELOCITY_WINDOW;
+    return (samples[first].time + samples[i].time) / 2;
+}
+
+// Dead band from the ramp: power when each wheel starts turning
+void findDeadBand(int d) {
+    deadBandL[d] = RAMP_POWER;
+    deadBandR[d] = RAMP_POWER;
+
+    for (int i = numSamples - 1; i >= 0; i--) {
+        if (samples[i].countsL - samples[0].countsL < MOVING_COUNTS) {
+            deadBandL[d] = i + 1 < numSamples ? fabs(samples[i + 1].powerL) : RAMP_POWER;
+            break;
+        }
+    }
+    for (int i = numSamples - 1; i >= 0; i--) {
+        if (samples[i].countsR - samples[0].countsR < MOVING_COUNTS) {
+            deadBandR[d] = i + 1 < numSamples ? fabs(samples[i + 1].powerR) : RAMP_POWER;
+            break;
+        }
+    }
+}
+
+// Steady state velocity and time constant of one step
+// Time constant is the time to 63% of steady state, 0 if the wheel didn't move
+// Steps cut short by RUN_LENGTH are left out
+void findStepResponse(int d, int step) {
+    float steadyStart = STEP_TIME - STEADY_TIME;
+    int steadyFirst = -1, last = -1;
+
+    for (int i = 0; i < numSamples; i++) {
+        if (steadyFirst < 0 && samples[i].time >= steadyStart) {
+            steadyFirst = i;
+        }
+        if (samples[i].time < STEP_TIME) {
+            last = i;
+        }
+    }
+
+    velocityL[d][step] = 0;
+    velocityR[d][step] = 0;
+    stepTauL[d][step] = 0;
+    stepTauR[d][step] = 0;
+    if (steadyFirst < 0 || last <= steadyFirst || cutTime < STEP_TIME) {
+        return;
+    }
+
+    float steadyTime = samples[last].time - samples[steadyFirst].time;
+    velocityL[d][step] = (samples[last].countsL - samples[steadyFirst].countsL) / steadyTime / TICKS_PER_INCH;
+    velocityR[d][step] = (samples[last].countsR - samples[steadyFirst].countsR) / steadyTime / TICKS_PER_INCH;
+
+    bool foundL = velocityL[d][step] <= 0, foundR = velocityR[d][step] <= 0;
+    for (int i = 0; i <= last && (!foundL || !foundR); i++) {
+        if (!foundL && velocity(i, true) >= 0.632 * velocityL[d][step]) {
+            stepTauL[d][step] = velocityTime(i);
+            foundL = true;
+        }
+        if (!foundR && velocity(i, false) >= 0.632 * velocityR[d][step]) {
+            stepTauR[d][step] = velocityTime(i);
+            foundR = true;
+        }
+    }
+}
+
+// Average of the step time constants that were found
+float averageTau(const float *taus) {
+    float sum = 0;
+    int steps = 0;
+    for (int step = 0; step < NUM_STEPS; step++) {
+        if (taus[step] > 0) {
+            sum += taus[step];
+            steps++;
+        }
+    }
+    return steps > 0 ? sum / steps : 0;
+}
+
+// Average left/right steady state velocity ratio over steps that moved
+float asymmetry(int d) {
+    float sum = 0;
+    int steps = 0;
+    for (int step = 0; step < NUM_STEPS; step++) {
+        if (velocityL[d][step] > 0 && velocityR[d][step] > 0) {
+            sum += velocityL[d][step] / velocityR[d][step];
+            steps++;
+        }
+    }
+    return steps > 0 ? sum / steps : 0;
+}
+
+// Shows results
+void displayResults() {
+    LCD.Clear(FEHLCD::Black);
+
+    // Steady state velocity curve (in/s)
+    LCD.WriteRC("P   L+   R+   L-   R-", 0, 0);
+    for (int step = 0; step < NUM_STEPS; step++) {
+        LCD.WriteRC(STEP_POWERS[step], step + 1, 0);
+        LCD.WriteRC(velocityL[0][step], step + 1, 4);
+        LCD.WriteRC(velocityR[0][step], step + 1, 9);
+        LCD.WriteRC(velocityL[1][step], step + 1, 14);
+        LCD.WriteRC(velocityR[1][step], step + 1, 19);
+    }
+
+    // Dead band (percent)
+    LCD.WriteRC("Dead", 8, 0);
+    LCD.WriteRC(deadBandL[0], 8, 4);
+    LCD.WriteRC(deadBandR[0], 8, 9);
+    LCD.WriteRC(deadBandL[1], 8, 14);
+    LCD.WriteRC(deadBandR[1], 8, 19);
+
+    // Time constant (s)
+    LCD.WriteRC("Tau", 9, 0);
+    LCD.WriteRC(timeConstantL[0], 9, 4);
+    LCD.WriteRC(timeConstantR[0], 9, 9);
+    LCD.WriteRC(timeConstantL[1], 9, 14);
+    LCD.WriteRC(timeConstantR[1], 9, 19);
+
+    // Left/right asymmetry (velocity ratio)
+    LCD.WriteRC("L/R+", 11, 0);
+    LCD.WriteRC(asymmetry(0), 11, 5);
+    LCD.WriteRC("L/R-", 12, 0);
+    LCD.WriteRC(asymmetry(1), 12, 5);
+}
+
 int main(void)
 {
-    float x,y;
-
     LCD.Clear(FEHLCD::Black);
     LCD.SetFontColor(FEHLCD::White);
 
-    // Loop through all power settings
-    for(int i = 55; i <= 100; i++) {
-        // Holds velocity
-        double velocity;
-
-        // Create new log
-        SD.OpenLog();
-
-        // Reset encoder counts
-        leftEnc.ResetCounts();
-        rightEnc.ResetCounts();
-
-        // Wait for 2 seconds
-        LCD.Write("Ready for ");
-        LCD.WriteLine(i);
-        LCD.WriteLine("");
-        Sleep(2000);
-
-        // Accelerate for 0.25 second
-        for(int j = 1; j <= 5; j++) {
-            leftBase.SetPercent(i * j / 5);
-            rightBase.SetPercent(- i * j / 5);
-            Sleep(50);
-        }
+    LCD.WriteLine("Characterizing");
+    LCD.WriteLine("Robot on the floor");
+    LCD.Write("Clear in front and behind (in): ");
+    LCD.WriteLine(RUN_LENGTH);
+    Sleep(2000);
+
+    // One log for the whole run
+    SD.OpenLog();
+    float offset = 0;
+
+    // Ramp, each step and chirp, each run forward then backward
+    for (int test = RAMP_TEST; test <= CHIRP_TEST; test++) {
+        int steps = test == STEP_TEST ? NUM_STEPS : 1;
+
+        for (int step = 0; step < steps; step++) {
+            for (int d = 0; d < 2; d++) {
+                int direction = d == 0 ? 1 : -1;
 
-        // Run for 1 second
-        float startTime = TimeNow();
-        while(TimeNow() - startTime < 1) {
-            SD.Printf("%f %d %d\n", TimeNow(), leftEnc.Counts(), rightEnc.Counts());
-            Sleep(10);
+                LCD.Write(direction > 0 ? "Forward " : "Backward ");
+                LCD.Write(test == RAMP_TEST ? "ramp" : (test == STEP_TEST ? "step " : "chirp"));
+                if (test == STEP_TEST) {
+                    LCD.Write(STEP_POWERS[step]);
+                }
+                LCD.WriteLine("");
+
+                runTest(test, step, direction);
+                if (cutTime < testLength(test)) {
+                    LCD.WriteLine("  cut at run length");
+                }
+
+                if (test == RAMP_TEST) {
+                    findDeadBand(d);
+                }
+                else if (test == STEP_TEST) {
+                    findStepResponse(d, step);
+                }
+
+                // Log while stopped, time keeps going between tests
+                writeSamples(offset);
+                offset += testLength(test) + REST_TIME;
+                Sleep((int)(REST_TIME * 1000));
+            }
         }
+    }
 
-        // Stop base
-        leftBase.SetPercent(0);
-        rightBase.SetPercent(0);
+    SD.CloseLog();
 
-        // Close log
-        SD.CloseLog();
+    for (int d = 0; d < 2; d++) {
+        timeConstantL[d] = averageTau(stepTauL[d]);
+        timeConstantR[d] = averageTau(stepTauR[d]);
     }
 
+    displayResults();
+
     return 0;
 }